@@ -0,0 +1,43 @@
+#include <atomic>
+
+#include <benchmark/benchmark.h>
+#include <bench/bench.h>
+#include <nonbiri/database.h>
+
+static std::atomic<uint64_t> sequence {};
+
+void Bench::openDatabase()
+{
+  Database::initialize(":memory:");
+}
+
+std::shared_ptr<Manga> Bench::makeManga()
+{
+  Manga_t manga {};
+  manga.path = "/manga/" + std::to_string(sequence++);
+  manga.coverUrl = "https://example.com/covers" + manga.path + ".jpg";
+  manga.title = "Benchmark Manga" + manga.path;
+  manga.description = std::string(512, 'd');
+  manga.status = MangaStatus::Ongoing;
+  manga.artists = {"Artist A", "Artist B"};
+  manga.authors = {"Author A"};
+  manga.genres = {"Action", "Comedy", "Drama", "Fantasy"};
+  return std::make_shared<Manga>("example.com", manga);
+}
+
+std::vector<std::shared_ptr<Chapter>> Bench::makeChapters(size_t count)
+{
+  std::vector<std::shared_ptr<Chapter>> chapters {};
+  chapters.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    Chapter_t chapter {};
+    chapter.publishedAt = 1600000000 + static_cast<int64_t>(i) * 86400;
+    chapter.path = "/chapter/" + std::to_string(sequence++);
+    chapter.name = "Chapter " + std::to_string(i + 1);
+    chapter.groups = {"Group A"};
+    chapters.push_back(std::make_shared<Chapter>("example.com", chapter));
+  }
+  return chapters;
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,23 @@
+#ifndef NONBIRI_BENCH_BENCH_H_
+#define NONBIRI_BENCH_BENCH_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nonbiri/models/chapter.h>
+#include <nonbiri/models/manga.h>
+
+namespace Bench
+{
+// In-memory database with the schema applied, shared by every benchmark.
+// Like the server, expects nonbiri.sql in the working directory.
+void openDatabase();
+
+// Sample data, the same on every run. Paths are unique across calls so the
+// results can be saved repeatedly.
+std::shared_ptr<Manga> makeManga();
+std::vector<std::shared_ptr<Chapter>> makeChapters(size_t count);
+}  // namespace Bench
+
+#endif  // NONBIRI_BENCH_BENCH_H_
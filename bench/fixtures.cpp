@@ -0,0 +1,124 @@
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <bench/bench.h>
+#include <nonbiri/cache.h>
+#include <nonbiri/http/client.h>
+#include <nonbiri/http/fixture.h>
+#include <nonbiri/manager.h>
+
+// End-to-end source calls through the manager, answered from fixtures made
+// with --http-record instead of the network. NONBIRI_BENCH_FIXTURES names the
+// fixture directory and NONBIRI_BENCH_EXTENSIONS the extensions they were
+// recorded with, NONBIRI_BENCH_DOMAIN picks one of them. The benchmarks are
+// skipped when these are not set. Response caches are cleared before every
+// call, so each one goes through the extension and its parser.
+
+struct Source
+{
+  std::shared_ptr<Extension> ext {};
+  std::string mangaPath {};
+  std::string chapterPath {};
+  std::string error {};
+};
+
+static Source openSource()
+{
+  Source source {};
+  const char *fixtures = getenv("NONBIRI_BENCH_FIXTURES");
+  const char *extensions = getenv("NONBIRI_BENCH_EXTENSIONS");
+  if (fixtures == nullptr || extensions == nullptr) {
+    source.error = "NONBIRI_BENCH_FIXTURES and NONBIRI_BENCH_EXTENSIONS are not set";
+    return source;
+  }
+
+  Bench::openDatabase();
+  HttpClient::initialize();
+  HttpFixture::initialize({HttpFixture::Mode::Replay, fixtures});
+  App::manager = new Manager(extensions);
+
+  const char *domain = getenv("NONBIRI_BENCH_DOMAIN");
+  const auto installed = App::manager->getExtensions();
+  if (installed.empty()) {
+    source.error = std::string("No extensions in ") + extensions;
+    return source;
+  }
+  source.ext = App::manager->getExtension(domain != nullptr ? domain : installed.begin()->first);
+  if (source.ext == nullptr) {
+    source.error = std::string("Extension not found: ") + (domain != nullptr ? domain : "");
+    return source;
+  }
+
+  // Whatever the recorded session opened first
+  try {
+    const auto &[manga, hasNext] = App::manager->getLatests(*source.ext, 1);
+    if (manga.empty()) {
+      source.error = "No latest manga in the fixtures";
+      return source;
+    }
+    source.mangaPath = manga.front()->path;
+    const auto chapters = App::manager->getChapters(*source.ext, source.mangaPath);
+    if (chapters.empty()) {
+      source.error = "No chapters of " + source.mangaPath + " in the fixtures";
+      return source;
+    }
+    source.chapterPath = chapters.front()->path;
+  } catch (const std::exception &e) {
+    source.error = e.what();
+  }
+  return source;
+}
+
+static const Source &source(benchmark::State &state)
+{
+  static const Source instance = openSource();
+  if (!instance.error.empty())
+    state.SkipWithError(instance.error.c_str());
+  return instance;
+}
+
+static void fixtureGetLatests(benchmark::State &state)
+{
+  const auto &s = source(state);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(App::manager->getLatests(*s.ext, 1));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(fixtureGetLatests)->Unit(benchmark::kMillisecond);
+
+static void fixtureGetManga(benchmark::State &state)
+{
+  const auto &s = source(state);
+  for (auto _ : state) {
+    Cache::manga.clear();
+    benchmark::DoNotOptimize(App::manager->getManga(*s.ext, s.mangaPath));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(fixtureGetManga)->Unit(benchmark::kMillisecond);
+
+static void fixtureGetChapters(benchmark::State &state)
+{
+  const auto &s = source(state);
+  for (auto _ : state) {
+    Cache::manga.clear();
+    Cache::chapters.clear();
+    benchmark::DoNotOptimize(App::manager->getChapters(*s.ext, s.mangaPath));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(fixtureGetChapters)->Unit(benchmark::kMillisecond);
+
+static void fixtureGetPages(benchmark::State &state)
+{
+  const auto &s = source(state);
+  for (auto _ : state) {
+    Cache::pages.clear();
+    benchmark::DoNotOptimize(App::manager->getPages(*s.ext, s.chapterPath));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(fixtureGetPages)->Unit(benchmark::kMillisecond);
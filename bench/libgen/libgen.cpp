@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <nonbiri/database.h>
+
+// Fills a database with a made up library the size of a heavy user's, to
+// look at query plans and timings at scale. The same seed always produces
+// the same library.
+
+struct Options
+{
+  std::string db {"library.db"};
+  unsigned int manga {100000};
+  // Average per manga, the actual count varies between 1 and twice that
+  unsigned int chapters {50};
+  unsigned int authors {30000};
+  unsigned int genres {20000};
+  unsigned int groups {5000};
+  unsigned int sources {20};
+  unsigned int seed {1};
+};
+
+static void usage()
+{
+  std::cerr << "Usage: nonbiri_libgen [options]\n"
+               "  --db <path>        database to fill (library.db)\n"
+               "  --manga <n>        manga (100000)\n"
+               "  --chapters <n>     average chapters per manga (50)\n"
+               "  --authors <n>      authors and artists (30000)\n"
+               "  --genres <n>       genres (20000)\n"
+               "  --groups <n>       scanlation groups (5000)\n"
+               "  --sources <n>      source domains (20)\n"
+               "  --seed <n>         random seed (1)\n";
+}
+
+static bool parse(int argc, char *argv[], Options &options)
+{
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc)
+      return false;
+    const int value = std::max(1, atoi(argv[i + 1]));
+    if (strcmp(argv[i], "--db") == 0)
+      options.db = argv[i + 1];
+    else if (strcmp(argv[i], "--manga") == 0)
+      options.manga = value;
+    else if (strcmp(argv[i], "--chapters") == 0)
+      options.chapters = value;
+    else if (strcmp(argv[i], "--authors") == 0)
+      options.authors = value;
+    else if (strcmp(argv[i], "--genres") == 0)
+      options.genres = value;
+    else if (strcmp(argv[i], "--groups") == 0)
+      options.groups = value;
+    else if (strcmp(argv[i], "--sources") == 0)
+      options.sources = value;
+    else if (strcmp(argv[i], "--seed") == 0)
+      options.seed = value;
+    else
+      return false;
+    i++;
+  }
+  return true;
+}
+
+class Statement
+{
+  sqlite3_stmt *stmt {};
+
+public:
+  Statement(const char *sql)
+  {
+    if (sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr) != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  }
+
+  ~Statement()
+  {
+    sqlite3_finalize(stmt);
+  }
+
+  Statement &bind(int index, int64_t value)
+  {
+    sqlite3_bind_int64(stmt, index, value);
+    return *this;
+  }
+
+  Statement &bind(int index, const std::string &value)
+  {
+    sqlite3_bind_text(stmt, index, value.c_str(), -1, SQLITE_TRANSIENT);
+    return *this;
+  }
+
+  void run()
+  {
+    const int exit = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (exit != SQLITE_DONE)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  }
+};
+
+static void exec(const char *sql)
+{
+  char *error {};
+  if (sqlite3_exec(Database::instance, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+    const std::string message {error};
+    sqlite3_free(error);
+    throw std::runtime_error(message);
+  }
+}
+
+class Generator
+{
+  const Options &options;
+  std::mt19937 random;
+  std::uniform_real_distribution<double> unit {0.0, 1.0};
+  // Around when the library was started
+  const int64_t epoch {1500000000};
+  const int64_t now {1700000000};
+
+  // A few names are very popular, most show up rarely
+  int64_t popular(unsigned int count)
+  {
+    const double u = unit(random);
+    return 1 + static_cast<int64_t>(u * u * u * count) % count;
+  }
+
+  int64_t between(int64_t min, int64_t max)
+  {
+    return std::uniform_int_distribution<int64_t>(min, max)(random);
+  }
+
+  std::string words(int count)
+  {
+    static const char *pool[] {"Blade", "Sky", "Tale", "Hero", "Moon", "Night", "Dragon", "Garden", "Sword", "Spring",
+                               "Shadow", "Star", "Ocean", "Witch", "King", "Flower", "Return", "Academy", "Dungeon",
+                               "Village", "Storm", "Winter", "Cafe", "Demon", "Prince", "Chronicle", "Summer"};
+    std::string result {};
+    for (int i = 0; i < count; i++) {
+      if (i > 0)
+        result += ' ';
+      result += pool[between(0, std::size(pool) - 1)];
+    }
+    return result;
+  }
+
+  void names(const char *table, const char *prefix, unsigned int count)
+  {
+    Statement insert {(std::string("INSERT INTO ") + table + " (id, name) VALUES (?, ?)").c_str()};
+    for (unsigned int i = 1; i <= count; i++)
+      insert.bind(1, i).bind(2, prefix + std::to_string(i)).run();
+  }
+
+public:
+  Generator(const Options &options) : options(options), random(options.seed) {}
+
+  void run()
+  {
+    const auto start = std::chrono::steady_clock::now();
+    {
+      Database::Tx tx {};
+      names("author", "Author ", options.authors);
+      names("genre", "Genre ", options.genres);
+      names("scanlation_group", "Group ", options.groups);
+    }
+    std::cout << "Names done" << std::endl;
+
+    Statement manga {
+      "INSERT INTO manga (id, domain, added_at, updated_at, last_read_at, last_viewed_at,"
+      " path, cover_url, title, description, status, reading_status)"
+      " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"};
+    Statement artist {"INSERT OR IGNORE INTO manga_artists (manga_id, author_id) VALUES (?, ?)"};
+    Statement author {"INSERT OR IGNORE INTO manga_authors (manga_id, author_id) VALUES (?, ?)"};
+    Statement genre {"INSERT OR IGNORE INTO manga_genres (manga_id, genre_id) VALUES (?, ?)"};
+    Statement chapter {
+      "INSERT INTO chapter (id, manga_id, domain, added_at, updated_at, published_at,"
+      " last_read_at, last_read_page, read_count, path, name, page_count)"
+      " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"};
+    Statement group {"INSERT OR IGNORE INTO chapter_scanlation_groups (chapter_id, scanlation_group_id) VALUES (?, ?)"};
+
+    int64_t chapterId {};
+    // Committed in batches so the journal stays small
+    static constexpr unsigned int batch {1000};
+    for (unsigned int first = 1; first <= options.manga; first += batch) {
+      Database::Tx tx {};
+      for (unsigned int id = first; id < first + batch && id <= options.manga; id++) {
+        const std::string domain {"source-" + std::to_string(between(1, options.sources)) + ".example"};
+        const std::string path {"/manga/" + std::to_string(id)};
+        const int64_t addedAt {between(epoch, now)};
+        const bool isRead {unit(random) < 0.3};
+        const int64_t lastReadAt {isRead ? between(addedAt, now) : 0};
+
+        manga.bind(1, id)
+          .bind(2, domain)
+          .bind(3, addedAt)
+          .bind(4, between(addedAt, now))
+          .bind(5, lastReadAt)
+          .bind(6, between(addedAt, now))
+          .bind(7, path)
+          .bind(8, "https://" + domain + "/covers" + path + ".jpg")
+          .bind(9, words(between(1, 4)) + " " + std::to_string(id))
+          .bind(10, words(between(10, 40)))
+          .bind(11, between(0, 4))
+          .bind(12, isRead ? between(1, 5) : 0)
+          .run();
+
+        for (int i = between(1, 2); i > 0; i--)
+          artist.bind(1, id).bind(2, popular(options.authors)).run();
+        for (int i = between(1, 2); i > 0; i--)
+          author.bind(1, id).bind(2, popular(options.authors)).run();
+        for (int i = between(3, 6); i > 0; i--)
+          genre.bind(1, id).bind(2, popular(options.genres)).run();
+
+        const int64_t count {between(1, options.chapters * 2 - 1)};
+        const int64_t readUpTo {isRead ? between(0, count) : 0};
+        for (int64_t n = 1; n <= count; n++) {
+          chapterId++;
+          const int64_t publishedAt {addedAt + (now - addedAt) * n / (count + 1)};
+          const bool isChapterRead {n <= readUpTo};
+          chapter.bind(1, chapterId)
+            .bind(2, id)
+            .bind(3, domain)
+            .bind(4, publishedAt)
+            .bind(5, publishedAt)
+            .bind(6, publishedAt)
+            .bind(7, isChapterRead ? between(publishedAt, now) : 0)
+            .bind(8, isChapterRead ? between(1, 40) : 0)
+            .bind(9, isChapterRead ? 1 : 0)
+            .bind(10, path + "/chapter/" + std::to_string(n))
+            .bind(11, "Chapter " + std::to_string(n))
+            .bind(12, between(10, 60))
+            .run();
+          group.bind(1, chapterId).bind(2, popular(options.groups)).run();
+        }
+      }
+
+      if ((first - 1) % (batch * 10) == 0)
+        std::cout << first - 1 << " manga, " << chapterId << " chapters" << std::endl;
+    }
+
+    // No ANALYZE, the plans should be the ones users get
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << options.manga << " manga and " << chapterId << " chapters in " << elapsed.count() << "s" << std::endl;
+  }
+};
+
+int main(int argc, char *argv[])
+{
+  Options options {};
+  if (!parse(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+
+  try {
+    Database::initialize(options.db);
+    sqlite3_stmt *stmt {};
+    sqlite3_prepare_v2(Database::instance, "SELECT 1 FROM manga LIMIT 1", -1, &stmt, nullptr);
+    const bool isEmpty = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    if (!isEmpty)
+      throw std::runtime_error(options.db + " already has a library, generate into a new file");
+
+    exec("PRAGMA synchronous = OFF");
+    exec("PRAGMA journal_mode = MEMORY");
+    Generator(options).run();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
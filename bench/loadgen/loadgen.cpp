@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <httplib.h>
+#include <json/json.h>
+#include <nonbiri/metrics.h>
+
+// Drives a running server at a fixed request rate and reports latency
+// percentiles, errors and throughput.
+//
+// Requests are sent open loop: each one is due at a fixed point in time and
+// its latency is measured from then, not from when a connection was free to
+// send it. A server that falls behind shows up in the percentiles instead of
+// quietly lowering the rate.
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+  std::string host {"127.0.0.1"};
+  int port {42081};
+  unsigned int rps {100};
+  unsigned int duration {30};
+  unsigned int warmup {5};
+  unsigned int connections {16};
+  bool json {};
+  std::vector<std::string> paths {};
+};
+
+struct Results
+{
+  Metrics::Histogram latency {};
+  std::atomic<uint64_t> maxLatency {};
+  std::atomic<uint64_t> completed {};
+  std::mutex errorsMutex {};
+  // Status code, 0 when no response came back at all
+  std::map<int, uint64_t> errors {};
+};
+
+struct Schedule
+{
+  std::mutex mutex {};
+  std::condition_variable cv {};
+  std::deque<std::pair<Clock::time_point, size_t>> due {};
+  bool isDone {};
+};
+
+static void usage()
+{
+  std::cerr << "Usage: nonbiri_loadgen [options] path...\n"
+               "  --host <host>         server address (127.0.0.1)\n"
+               "  --port <port>         server port (42081)\n"
+               "  --rps <n>             requests per second (100)\n"
+               "  --duration <s>        seconds to measure (30)\n"
+               "  --warmup <s>          seconds to run before measuring (5)\n"
+               "  --connections <n>     concurrent connections (16)\n"
+               "  --json                print the results as JSON\n"
+               "Paths are requested in turn, e.g. \"/api/chapters?domain=synthetic.local&path=/manga/1\".\n";
+}
+
+static bool parse(int argc, char *argv[], Options &options)
+{
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+      options.host = argv[++i];
+    } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+      options.port = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--rps") == 0 && i + 1 < argc) {
+      options.rps = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+      options.duration = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+      options.warmup = std::max(0, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc) {
+      options.connections = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--json") == 0) {
+      options.json = true;
+    } else if (argv[i][0] == '/') {
+      options.paths.push_back(argv[i]);
+    } else {
+      return false;
+    }
+  }
+  return !options.paths.empty();
+}
+
+static void dispatch(const Options &options, Clock::time_point start, Schedule &schedule)
+{
+  const uint64_t total = static_cast<uint64_t>(options.rps) * (options.warmup + options.duration);
+  const auto interval = std::chrono::nanoseconds(1000000000 / options.rps);
+
+  for (uint64_t i = 0; i < total; i++) {
+    const auto due = start + interval * i;
+    std::this_thread::sleep_until(due);
+    {
+      std::lock_guard lock(schedule.mutex);
+      schedule.due.push_back({due, i});
+    }
+    schedule.cv.notify_one();
+  }
+
+  std::lock_guard lock(schedule.mutex);
+  schedule.isDone = true;
+  schedule.cv.notify_all();
+}
+
+static void run(const Options &options, Clock::time_point measureFrom, Schedule &schedule, Results &results)
+{
+  httplib::Client client(options.host, options.port);
+  client.set_keep_alive(true);
+  client.set_read_timeout(60);
+
+  while (true) {
+    std::pair<Clock::time_point, size_t> next {};
+    {
+      std::unique_lock lock(schedule.mutex);
+      schedule.cv.wait(lock, [&]() { return schedule.isDone || !schedule.due.empty(); });
+      if (schedule.due.empty())
+        return;
+      next = schedule.due.front();
+      schedule.due.pop_front();
+    }
+
+    const auto &[due, index] = next;
+    const auto response = client.Get(options.paths[index % options.paths.size()].c_str());
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - due);
+    if (due < measureFrom)
+      continue;
+
+    results.completed++;
+    results.latency.observe(elapsed);
+    uint64_t max = results.maxLatency.load();
+    while (static_cast<uint64_t>(elapsed.count()) > max && !results.maxLatency.compare_exchange_weak(max, elapsed.count())) {}
+
+    const int status = response ? response->status : 0;
+    if (status < 200 || status >= 400) {
+      std::lock_guard lock(results.errorsMutex);
+      results.errors[status]++;
+    }
+  }
+}
+
+static void report(const Options &options, Results &results, std::chrono::duration<double> elapsed)
+{
+  static constexpr std::pair<const char *, double> percentiles[] {
+    {"p50", 0.5},
+    {"p90", 0.9},
+    {"p99", 0.99},
+    {"p999", 0.999},
+  };
+
+  uint64_t errors {};
+  for (const auto &[status, count] : results.errors)
+    errors += count;
+  const double throughput = results.completed / elapsed.count();
+  // Buckets report their upper bound, which may lie past the slowest request
+  const auto quantile = [&](double q) { return std::min(results.latency.quantile(q), results.maxLatency.load()) / 1000.0; };
+
+  if (options.json) {
+    Json::Value root {};
+    root["rps"] = options.rps;
+    root["connections"] = options.connections;
+    root["duration"] = elapsed.count();
+    root["requests"] = static_cast<Json::UInt64>(results.completed.load());
+    root["throughput"] = throughput;
+    root["errors"] = static_cast<Json::UInt64>(errors);
+    for (const auto &[status, count] : results.errors)
+      root["statuses"][std::to_string(status)] = static_cast<Json::UInt64>(count);
+    for (const auto &[name, q] : percentiles)
+      root["latency"][name] = quantile(q);
+    root["latency"]["max"] = results.maxLatency.load() / 1000.0;
+    for (const auto &path : options.paths)
+      root["paths"].append(path);
+
+    Json::FastWriter writer {};
+    std::cout << writer.write(root);
+    return;
+  }
+
+  std::cout << "Requests:   " << results.completed << " in " << elapsed.count() << "s\n";
+  std::cout << "Throughput: " << throughput << " req/s (target " << options.rps << ")\n";
+  std::cout << "Errors:     " << errors;
+  for (const auto &[status, count] : results.errors)
+    std::cout << " [" << (status == 0 ? "no response" : std::to_string(status)) << ": " << count << "]";
+  std::cout << "\nLatency (ms):";
+  for (const auto &[name, q] : percentiles)
+    std::cout << " " << name << "=" << quantile(q);
+  std::cout << " max=" << results.maxLatency.load() / 1000.0 << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  Options options {};
+  if (!parse(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+
+  Schedule schedule {};
+  Results results {};
+  const auto start = Clock::now() + std::chrono::milliseconds(100);
+  const auto measureFrom = start + std::chrono::seconds(options.warmup);
+
+  std::vector<std::thread> connections {};
+  for (unsigned int i = 0; i < options.connections; i++)
+    connections.emplace_back(run, std::cref(options), measureFrom, std::ref(schedule), std::ref(results));
+
+  dispatch(options, start, schedule);
+  for (auto &connection : connections)
+    connection.join();
+
+  report(options, results, Clock::now() - measureFrom);
+  return results.completed > 0 ? 0 : 1;
+}
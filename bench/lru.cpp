@@ -0,0 +1,61 @@
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <bench/bench.h>
+#include <nonbiri/lru.h>
+
+static constexpr int keyCount {1024};
+
+static LRU<std::shared_ptr<Manga>> &cache()
+{
+  static LRU<std::shared_ptr<Manga>> instance("bench", keyCount);
+  return instance;
+}
+
+static const std::vector<std::string> &keys()
+{
+  static const std::vector<std::string> instance = []() {
+    std::vector<std::string> keys {};
+    for (int i = 0; i < keyCount * 2; i++)
+      keys.push_back("example.com/manga/" + std::to_string(i));
+    return keys;
+  }();
+  return instance;
+}
+
+// Half of the lookups miss, as they would for a cold library
+static void lruGet(benchmark::State &state)
+{
+  if (state.thread_index() == 0) {
+    for (int i = 0; i < keyCount; i++)
+      cache().set(keys()[i], std::make_shared<Manga>());
+  }
+
+  std::mt19937 random(state.thread_index());
+  std::uniform_int_distribution<size_t> index(0, keys().size() - 1);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(cache().get(keys()[index(random)]));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(lruGet)->ThreadRange(1, 16)->UseRealTime();
+
+// One write for every nine reads
+static void lruMixed(benchmark::State &state)
+{
+  const auto value = std::make_shared<Manga>();
+  std::mt19937 random(state.thread_index());
+  std::uniform_int_distribution<size_t> index(0, keys().size() - 1);
+  uint64_t i {};
+  for (auto _ : state) {
+    const auto &key = keys()[index(random)];
+    if (i++ % 10 == 0)
+      cache().set(key, value);
+    else
+      benchmark::DoNotOptimize(cache().get(key));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(lruMixed)->ThreadRange(1, 16)->UseRealTime();
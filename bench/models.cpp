@@ -0,0 +1,65 @@
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <bench/bench.h>
+
+static void mangaSave(benchmark::State &state)
+{
+  Bench::openDatabase();
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto manga = Bench::makeManga();
+    state.ResumeTiming();
+    manga->save();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(mangaSave);
+
+static void mangaFind(benchmark::State &state)
+{
+  Bench::openDatabase();
+  std::vector<std::shared_ptr<Manga>> mangas {};
+  for (int i = 0; i < 1000; i++) {
+    mangas.push_back(Bench::makeManga());
+    mangas.back()->save();
+  }
+
+  std::mt19937 random {};
+  std::uniform_int_distribution<size_t> index(0, mangas.size() - 1);
+  for (auto _ : state) {
+    const auto &manga = mangas[index(random)];
+    benchmark::DoNotOptimize(Manga::find(manga->domain, manga->path));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(mangaFind);
+
+static void chapterSaveAll(benchmark::State &state)
+{
+  Bench::openDatabase();
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto manga = Bench::makeManga();
+    manga->save();
+    const auto chapters = Bench::makeChapters(state.range(0));
+    state.ResumeTiming();
+    Chapter::saveAll(chapters, manga->id);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(chapterSaveAll)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMillisecond);
+
+static void chapterFindAll(benchmark::State &state)
+{
+  Bench::openDatabase();
+  auto manga = Bench::makeManga();
+  manga->save();
+  Chapter::saveAll(Bench::makeChapters(state.range(0)), manga->id);
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(Chapter::findAll(manga->id));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(chapterFindAll)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMicrosecond);
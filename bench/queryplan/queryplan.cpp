@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+#include <nonbiri/database.h>
+#include <nonbiri/models/chapter.h>
+#include <nonbiri/models/download.h>
+#include <nonbiri/models/entity.h>
+#include <nonbiri/models/history.h>
+#include <nonbiri/models/manga.h>
+#include <nonbiri/models/update.h>
+
+// Runs every model query against a library made by nonbiri_libgen and
+// fails if any of them scans a whole table. The statements are picked up
+// from SQLite as the models run them, so new queries are covered without
+// listing them here. Each one is timed as well.
+
+struct Options
+{
+  std::string db {"library.db"};
+  unsigned int iterations {100};
+  bool json {};
+};
+
+struct Stats
+{
+  uint64_t count {};
+  uint64_t total {};
+  uint64_t max {};
+  std::vector<std::string> plan {};
+  bool isScan {};
+};
+
+static std::map<std::string, Stats> statements {};
+// SQLite's own profile timings only have millisecond resolution
+static std::map<void *, std::chrono::steady_clock::time_point> started {};
+
+static void usage()
+{
+  std::cerr << "Usage: nonbiri_queryplan [options]\n"
+               "  --db <path>          library made by nonbiri_libgen (library.db)\n"
+               "  --iterations <n>     times to run each query (100)\n"
+               "  --json               print the results as JSON\n"
+               "The library is modified, run it on a copy.\n";
+}
+
+static bool parse(int argc, char *argv[], Options &options)
+{
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--db") == 0 && i + 1 < argc)
+      options.db = argv[++i];
+    else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+      options.iterations = std::max(1, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--json") == 0)
+      options.json = true;
+    else
+      return false;
+  }
+  return true;
+}
+
+static int onTrace(unsigned int type, void *, void *stmt, void *)
+{
+  const auto now = std::chrono::steady_clock::now();
+  if (type == SQLITE_TRACE_STMT) {
+    started.emplace(stmt, now);
+    return 0;
+  }
+
+  const auto it = started.find(stmt);
+  if (it == started.end())
+    return 0;
+  const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - it->second).count();
+  started.erase(it);
+
+  const char *sql = sqlite3_sql(static_cast<sqlite3_stmt *>(stmt));
+  if (sql == nullptr || strncmp(sql, "BEGIN", 5) == 0 || strncmp(sql, "COMMIT", 6) == 0 || strncmp(sql, "ROLLBACK", 8) == 0)
+    return 0;
+
+  auto &stats = statements[sql];
+  stats.count++;
+  stats.total += ns;
+  stats.max = std::max<uint64_t>(stats.max, ns);
+  return 0;
+}
+
+static int64_t count(const char *table)
+{
+  sqlite3_stmt *stmt {};
+  const std::string sql {std::string("SELECT MAX(id) FROM ") + table};
+  if (sqlite3_prepare_v2(Database::instance, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  const int64_t result = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+  sqlite3_finalize(stmt);
+  return result;
+}
+
+// libgen numbers manga without gaps
+static std::pair<std::string, std::string> mangaAt(int64_t id)
+{
+  sqlite3_stmt *stmt {};
+  sqlite3_prepare_v2(Database::instance, "SELECT domain, path FROM manga WHERE id = ?", -1, &stmt, nullptr);
+  sqlite3_bind_int64(stmt, 1, id);
+  std::pair<std::string, std::string> result {};
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    result = {reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)), reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1))};
+  sqlite3_finalize(stmt);
+  return result;
+}
+
+// Exercises every model query the server runs
+static void workload(const Options &options)
+{
+  const int64_t mangaCount = count("manga");
+  const int64_t authorCount = count("author");
+  const int64_t genreCount = count("genre");
+  if (mangaCount == 0)
+    throw std::runtime_error(options.db + " is empty, fill it with nonbiri_libgen first");
+
+  std::mt19937 random {};
+  const auto pick = [&](int64_t max) { return std::uniform_int_distribution<int64_t>(1, std::max<int64_t>(1, max))(random); };
+
+  std::vector<std::pair<std::string, std::string>> targets {};
+  for (unsigned int i = 0; i < options.iterations; i++)
+    targets.push_back(mangaAt(pick(mangaCount)));
+  // Earlier runs left their manga behind
+  const std::string run {std::to_string(std::chrono::system_clock::now().time_since_epoch().count())};
+  // Chapter list deltas are asked for since the start of the run
+  const int64_t since {Chapter::lastChange()};
+
+  sqlite3_trace_v2(Database::instance, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE, onTrace, nullptr);
+  for (unsigned int i = 0; i < options.iterations; i++) {
+    const auto &[domain, path] = targets[i];
+
+    const auto manga = Manga::find(domain, path);
+    if (manga == nullptr)
+      continue;
+    Manga::exists(domain, path);
+    Manga::getReadState(domain, path);
+    Manga::setReadState(ReadingStatus::Reading, domain, path);
+
+    const auto chapters = manga->getChapters();
+    if (!chapters.empty()) {
+      const auto chapter = Chapter::find(domain, chapters[pick(chapters.size()) - 1]->path);
+      chapter->pages = {"https://queryplan.example/1.jpg", "https://queryplan.example/2.jpg"};
+      chapter->savePages();
+      Chapter::find(chapter->id);
+
+      Download::add(chapter->id);
+      Download::fail(chapter->id, "queryplan");
+      Download::findAll();
+      Download::remove(chapter->id);
+
+      History history {};
+      history.domain = domain;
+      history.mangaPath = path;
+      history.mangaTitle = manga->title;
+      history.chapterPath = chapter->path;
+      history.chapterName = chapter->name;
+      history.save();
+    }
+    Manga::findAllFollowed();
+    Chapter::lastChange();
+    Chapter::findChanged(manga->id, since);
+
+    Entity::find("author", "author " + std::to_string(pick(authorCount)));
+    Entity::find("genre", "GENRE " + std::to_string(pick(genreCount)));
+    Entity::find("scanlation_group", "Group " + std::to_string(pick(100)));
+
+    Manga_t data {};
+    data.path = "/queryplan/" + run + "/" + std::to_string(i);
+    data.coverUrl = "https://queryplan.example/cover.jpg";
+    data.title = "Query Plan " + std::to_string(i);
+    data.artists = {"Author " + std::to_string(pick(authorCount))};
+    data.authors = {"Author " + std::to_string(pick(authorCount)), "New Author " + std::to_string(i)};
+    data.genres = {"Genre " + std::to_string(pick(genreCount)), "Genre " + std::to_string(pick(genreCount))};
+    Manga added("queryplan.example", data);
+    added.save();
+    added.update();
+
+    std::vector<std::shared_ptr<Chapter>> newChapters {};
+    for (int n = 1; n <= 10; n++) {
+      Chapter_t chapter {};
+      chapter.publishedAt = n;
+      chapter.path = data.path + "/chapter/" + std::to_string(n);
+      chapter.name = "Chapter " + std::to_string(n);
+      newChapters.push_back(std::make_shared<Chapter>("queryplan.example", chapter));
+    }
+    Chapter::saveAll(newChapters, added.id);
+    Update::addAll(added, newChapters);
+
+    const auto updates = Update::findAll(0, 50);
+    if (!updates.empty())
+      Update::findAll(updates.back()->id, 50);
+    const auto history = History::findAll(0, 50);
+    if (!history.empty())
+      History::findAll(history.back()->id, 50);
+    History::compact(1000);
+  }
+  sqlite3_trace_v2(Database::instance, 0, nullptr, nullptr);
+}
+
+// Walk a table on purpose. The download queue is read whole, it is short
+// and every entry is shown. Trims step back from the newest row in id order
+// and stop at the offset.
+static bool isExpectedScan(const std::string &sql)
+{
+  return sql.rfind("SELECT q.chapter_id", 0) == 0 || sql.find("ORDER BY id DESC LIMIT 1 OFFSET ?") != std::string::npos;
+}
+
+static void explain()
+{
+  for (auto &[sql, stats] : statements) {
+    sqlite3_stmt *stmt {};
+    const std::string query {"EXPLAIN QUERY PLAN " + sql};
+    if (sqlite3_prepare_v2(Database::instance, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+      continue;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      const std::string detail {reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3))};
+      stats.plan.push_back(detail);
+      // SEARCH uses an index to find rows, SCAN visits all of them
+      if (detail.rfind("SCAN ", 0) == 0 && detail != "SCAN CONSTANT ROW" && !isExpectedScan(sql))
+        stats.isScan = true;
+    }
+    sqlite3_finalize(stmt);
+  }
+}
+
+static bool report(const Options &options)
+{
+  bool isOk {true};
+  Json::Value root(Json::arrayValue);
+  for (const auto &[sql, stats] : statements) {
+    isOk = isOk && !stats.isScan;
+    if (options.json) {
+      Json::Value entry {};
+      entry["sql"] = sql;
+      entry["scan"] = stats.isScan;
+      entry["count"] = static_cast<Json::UInt64>(stats.count);
+      entry["avgMs"] = stats.total / 1e6 / stats.count;
+      entry["maxMs"] = stats.max / 1e6;
+      entry["plan"] = Json::arrayValue;
+      for (const auto &line : stats.plan)
+        entry["plan"].append(line);
+      root.append(entry);
+      continue;
+    }
+
+    std::cout << (stats.isScan ? "SCAN " : "ok   ") << std::fixed << std::setprecision(3) << std::setw(9)
+              << stats.total / 1e6 / stats.count << "ms avg " << std::setw(9) << stats.max / 1e6 << "ms max  " << sql << "\n";
+    for (const auto &line : stats.plan)
+      std::cout << "       " << line << "\n";
+  }
+
+  if (options.json) {
+    Json::FastWriter writer {};
+    std::cout << writer.write(root);
+  } else {
+    std::cout << statements.size() << " statements, " << (isOk ? "no full table scans" : "full table scans found") << std::endl;
+  }
+  return isOk;
+}
+
+int main(int argc, char *argv[])
+{
+  Options options {};
+  if (!parse(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+
+  try {
+    Database::initialize(options.db);
+    workload(options);
+    explain();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return report(options) ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nonbiri/log.h>
+#include <nonbiri/sandbox.h>
+
+// Loads the synthetic extension in an isolated worker, makes it crash and
+// hang, and fails unless every misbehaving call comes back as an error and
+// the next one is answered by a fresh worker. Filters and prefs are checked
+// to make it across the socket when the extension has them.
+
+struct Options
+{
+  std::string extension {"extensions/synthetic.local.so"};
+  unsigned int timeout {2};
+};
+
+static void usage()
+{
+  std::cerr << "Usage: nonbiri_sandboxcheck [options]\n"
+               "  --extension <path>   synthetic extension (extensions/synthetic.local.so)\n"
+               "  --timeout <seconds>  call timeout given to the worker (2)\n";
+}
+
+static bool parse(int argc, char *argv[], Options &options)
+{
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--extension") == 0 && i + 1 < argc)
+      options.extension = argv[++i];
+    else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc)
+      options.timeout = std::max(1, atoi(argv[++i]));
+    else
+      return false;
+  }
+  return true;
+}
+
+static bool check(const std::string &name, const std::function<std::string()> &fn)
+{
+  std::string error {};
+  try {
+    error = fn();
+  } catch (const std::exception &e) {
+    error = e.what();
+  }
+  std::cout << (error.empty() ? "ok   " : "FAIL ") << name << (error.empty() ? "" : ": " + error) << std::endl;
+  return error.empty();
+}
+
+// Empty when fn threw as it should
+static std::string expectError(const std::function<void()> &fn)
+{
+  try {
+    fn();
+  } catch (const std::exception &) {
+    return {};
+  }
+  return "did not fail";
+}
+
+static std::string expectPages(Sandbox::IsolatedExtension &ext)
+{
+  return ext.getPages("/manga/0/chapter/1").empty() ? "no pages" : "";
+}
+
+static bool run(const Options &options)
+{
+  setenv("NONBIRI_SYNTHETIC_DELAY", "0", 1);
+  setenv("NONBIRI_SYNTHETIC_FAULTS", "1", 1);
+
+  // A single worker, so each call after a failure needs a new one
+  Sandbox::IsolatedExtension ext(options.extension, {1, 0, 0, options.timeout});
+
+  bool isOk {true};
+  isOk &= check("getLatests", [&] { return std::get<0>(ext.getLatests(1)).empty() ? "no entries" : ""; });
+  isOk &= check("getPages", [&] { return expectPages(ext); });
+
+  isOk &= check("crash is an error", [&] { return expectError([&] { ext.getPages("/manga/0/chapter/crash"); }); });
+  isOk &= check("recovers after crash", [&] { return expectPages(ext); });
+
+  isOk &= check("hang times out", [&] {
+    const auto start = std::chrono::steady_clock::now();
+    const auto error = expectError([&] { ext.getPages("/manga/0/chapter/hang"); });
+    if (!error.empty())
+      return error;
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed < std::chrono::seconds(options.timeout + 2) ? std::string {} : "took too long";
+  });
+  isOk &= check("recovers after hang", [&] { return expectPages(ext); });
+
+  if (ext.hasFilters) {
+    isOk &= check("filters", [&] { return ext.getFilters().isArray() ? "" : "not a list"; });
+    isOk &= check("search with filters", [&] {
+      std::vector<std::pair<std::string, std::string>> filters {};
+      for (const auto &key : ext.getFilterKeys())
+        filters.emplace_back(key, "");
+      return std::get<0>(ext.searchManga(1, "check", filters)).empty() ? "no entries" : "";
+    });
+  } else {
+    std::cout << "skip filters, the extension has none" << std::endl;
+  }
+
+  if (ext.hasPrefs) {
+    isOk &= check("prefs", [&] { return ext.getPrefs().isNull() ? "none returned" : ""; });
+    // Written twice so the worker started after the crash only gets the
+    // last value of the pref, and it has to show in what the source returns
+    isOk &= check("prefs survive a crash", [&] {
+      Json::Value prefs {};
+      prefs["pages"] = 5;
+      ext.setPrefs(prefs);
+      prefs["pages"] = 7;
+      ext.setPrefs(prefs);
+      if (const auto error = expectError([&] { ext.getPages("/manga/0/chapter/crash"); }); !error.empty())
+        return "crash " + error;
+      if (ext.getPrefs()["pages"] != 7)
+        return std::string {"prefs changed"};
+      const auto pages = ext.getPages("/manga/0/chapter/1").size();
+      return pages == 7 ? std::string {} : std::to_string(pages) + " pages instead of 7";
+    });
+  } else {
+    std::cout << "skip prefs, the extension has none" << std::endl;
+  }
+  return isOk;
+}
+
+int main(int argc, char *argv[])
+{
+  // The workers are started from this binary too
+  if (argc > 1 && strcmp(argv[1], "--worker") == 0) {
+    const int code = Sandbox::serve();
+    Log::flush();
+    return code;
+  }
+
+  Options options {};
+  if (!parse(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+
+  bool isOk {};
+  try {
+    isOk = run(options);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+  }
+  std::cout << (isOk ? "Isolated workers recover" : "Isolated workers do not recover") << std::endl;
+  Log::flush();
+  return isOk ? 0 : 1;
+}
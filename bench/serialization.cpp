@@ -0,0 +1,56 @@
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <bench/bench.h>
+#include <nonbiri/database.h>
+
+static std::vector<std::string> pagesOf(size_t count)
+{
+  std::vector<std::string> pages {};
+  for (size_t i = 0; i < count; i++)
+    pages.push_back("https://cdn.example.com/data/0123456789abcdef/" + std::to_string(i + 1) + ".jpg");
+  return pages;
+}
+
+static void serializeArray(benchmark::State &state)
+{
+  const auto pages = pagesOf(state.range(0));
+  for (auto _ : state)
+    benchmark::DoNotOptimize(Database::serializeArray(pages));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(serializeArray)->RangeMultiplier(4)->Range(4, 256);
+
+static void deserializeArray(benchmark::State &state)
+{
+  const auto serialized = Database::serializeArray(pagesOf(state.range(0)));
+  for (auto _ : state)
+    benchmark::DoNotOptimize(Database::deserializeArray(serialized));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(deserializeArray)->RangeMultiplier(4)->Range(4, 256);
+
+static void mangaToJson(benchmark::State &state)
+{
+  const auto manga = Bench::makeManga();
+  Json::FastWriter writer {};
+  for (auto _ : state)
+    benchmark::DoNotOptimize(writer.write(manga->toJson()));
+}
+BENCHMARK(mangaToJson);
+
+// The shape of a chapter list response
+static void chaptersToJson(benchmark::State &state)
+{
+  const auto chapters = Bench::makeChapters(state.range(0));
+  Json::FastWriter writer {};
+  for (auto _ : state) {
+    Json::Value root(Json::arrayValue);
+    for (const auto &chapter : chapters)
+      root.append(chapter->toJson());
+    benchmark::DoNotOptimize(writer.write(root));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(chaptersToJson)->RangeMultiplier(10)->Range(10, 10000);
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <core/core.h>
+#include <core/prefs.h>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+#  define SYNTHETIC_EXPORT extern "C" __declspec(dllexport)
+#else
+#  define SYNTHETIC_EXPORT extern "C"
+#endif
+
+// A source that never touches the network. Every call sleeps for a while
+// and returns made up data of a configurable size, so the server can be
+// load tested on its own. Tuned through the environment of the server:
+//   NONBIRI_SYNTHETIC_DELAY     milliseconds per call (50)
+//   NONBIRI_SYNTHETIC_JITTER    up to this many milliseconds more or less (0)
+//   NONBIRI_SYNTHETIC_ENTRIES   manga per page of latests/search (24)
+//   NONBIRI_SYNTHETIC_CHAPTERS  chapters per manga (200)
+//   NONBIRI_SYNTHETIC_PAGES     pages per chapter (20)
+//   NONBIRI_SYNTHETIC_FAULTS    1 to have getPages of chapters ending in
+//                               /crash abort and /hang never return (0)
+// Pages per chapter is also a pref, {"pages": n}, so setting prefs can be
+// told apart in what the source returns.
+class Synthetic : public Extension, public Prefs
+{
+  const int delay;
+  const int jitter;
+  const int entries;
+  const int chapters;
+  std::atomic<int> pages;
+  const bool hasFaults;
+
+  static int option(const char *name, int fallback)
+  {
+    const char *value = getenv(name);
+    return value != nullptr ? std::max(0, atoi(value)) : fallback;
+  }
+
+  void wait() const
+  {
+    int ms {delay};
+    if (jitter > 0) {
+      thread_local std::mt19937 random(std::hash<std::thread::id> {}(std::this_thread::get_id()));
+      ms += std::uniform_int_distribution<int>(-jitter, jitter)(random);
+    }
+    if (ms > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+
+  std::shared_ptr<Manga_t> makeManga(const std::string &path) const
+  {
+    auto manga = std::make_shared<Manga_t>();
+    manga->path = path;
+    manga->coverUrl = baseUrl + "/covers" + path + ".jpg";
+    manga->title = "Synthetic" + path;
+    manga->description = std::string(256, 'd');
+    manga->status = MangaStatus::Ongoing;
+    manga->artists = {"Artist"};
+    manga->authors = {"Author"};
+    manga->genres = {"Action", "Comedy", "Drama"};
+    return manga;
+  }
+
+  std::tuple<std::vector<std::shared_ptr<Manga_t>>, bool> makePage(int page, const std::string &prefix) const
+  {
+    std::vector<std::shared_ptr<Manga_t>> result {};
+    for (int i = 0; i < entries; i++)
+      result.push_back(makeManga("/manga/" + prefix + std::to_string((page - 1) * entries + i)));
+    return {result, page < 100};
+  }
+
+public:
+  Synthetic() :
+    delay {option("NONBIRI_SYNTHETIC_DELAY", 50)},
+    jitter {option("NONBIRI_SYNTHETIC_JITTER", 0)},
+    entries {option("NONBIRI_SYNTHETIC_ENTRIES", 24)},
+    chapters {option("NONBIRI_SYNTHETIC_CHAPTERS", 200)},
+    pages {option("NONBIRI_SYNTHETIC_PAGES", 20)},
+    hasFaults {option("NONBIRI_SYNTHETIC_FAULTS", 0) > 0}
+  {
+    domain = "synthetic.local";
+    name = "Synthetic";
+    description = "Made up data for load testing";
+    language = "en";
+    version = "1.0.0";
+    baseUrl = "https://synthetic.local";
+  }
+
+  Json::Value toJson() const override
+  {
+    Json::Value result {};
+    result["pages"] = pages.load();
+    return result;
+  }
+
+  void update(const Json::Value &prefs) override
+  {
+    if (prefs.isObject() && prefs["pages"].isInt())
+      pages = std::max(0, prefs["pages"].asInt());
+  }
+
+  std::tuple<std::vector<std::shared_ptr<Manga_t>>, bool> getLatests(int page) override
+  {
+    wait();
+    return makePage(page, "");
+  }
+
+  std::tuple<std::vector<std::shared_ptr<Manga_t>>, bool> searchManga(
+    int page, const std::string &query, const std::vector<std::pair<std::string, std::string>> &) override
+  {
+    wait();
+    return makePage(page, query + "-");
+  }
+
+  std::shared_ptr<Manga_t> getManga(const std::string &path) override
+  {
+    wait();
+    return makeManga(path);
+  }
+
+  std::vector<std::shared_ptr<Chapter_t>> getChapters(const std::string &path) override
+  {
+    wait();
+    std::vector<std::shared_ptr<Chapter_t>> result {};
+    for (int i = chapters; i > 0; i--) {
+      auto chapter = std::make_shared<Chapter_t>();
+      chapter->publishedAt = 1600000000 + static_cast<int64_t>(i) * 86400;
+      chapter->path = path + "/chapter/" + std::to_string(i);
+      chapter->name = "Chapter " + std::to_string(i);
+      chapter->groups = {"Group"};
+      result.push_back(chapter);
+    }
+    return result;
+  }
+
+  std::vector<std::string> getPages(const std::string &path) override
+  {
+    if (hasFaults && path.ends_with("/crash"))
+      abort();
+    while (hasFaults && path.ends_with("/hang"))
+      std::this_thread::sleep_for(std::chrono::hours(1));
+
+    wait();
+    std::vector<std::string> result {};
+    const int count {pages};
+    for (int i = 1; i <= count; i++)
+      result.push_back(baseUrl + "/data" + path + "/" + std::to_string(i) + ".jpg");
+    return result;
+  }
+};
+
+SYNTHETIC_EXPORT Extension *create()
+{
+  return new Synthetic();
+}
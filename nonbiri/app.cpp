@@ -1,17 +1,75 @@
+#include <algorithm>
+#include <chrono>
 #include <mutex>
+#include <optional>
 #include <thread>
 
 #include <core/core.h>
 #include <nonbiri/app.h>
 #include <nonbiri/controllers/api.h>
+#include <nonbiri/controllers/debug.h>
 #include <nonbiri/controllers/web.h>
 #include <nonbiri/database.h>
+#include <nonbiri/downloads.h>
+#include <nonbiri/http/cache.h>
+#include <nonbiri/http/client.h>
+#include <nonbiri/http/fixture.h>
+#include <nonbiri/http/pool.h>
+#include <nonbiri/images.h>
+#include <nonbiri/log.h>
 #include <nonbiri/manager.h>
+#include <nonbiri/models/history.h>
+#include <nonbiri/prefetch.h>
+#include <nonbiri/search.h>
 #include <nonbiri/server.h>
+#include <nonbiri/updates.h>
 
 bool App::daemonize {};
 int App::port {42081};
 
+unsigned int App::localThreads {4};
+unsigned int App::localQueue {32};
+unsigned int App::remoteThreads {8};
+unsigned int App::remoteQueue {16};
+
+unsigned int App::extensionTtl {600};
+
+bool App::isolateExtensions {};
+unsigned int App::extensionWorkers {2};
+unsigned int App::extensionCpuLimit {300};
+unsigned int App::extensionMemoryLimit {1024};
+unsigned int App::extensionTimeout {30};
+
+unsigned int App::httpPrewarm {4};
+unsigned int App::httpCacheSize {128};
+std::string App::httpRecord {};
+std::string App::httpReplay {};
+unsigned int App::httpLatency {};
+unsigned int App::httpJitter {};
+
+unsigned int App::imageCacheSize {1024};
+
+unsigned int App::prefetchThreads {2};
+unsigned int App::prefetchChapters {2};
+unsigned int App::prefetchPerSource {1};
+unsigned int App::prefetchImages {};
+
+unsigned int App::searchThreads {8};
+unsigned int App::searchPerSource {2};
+
+unsigned int App::downloadThreads {2};
+unsigned int App::downloadPerSource {1};
+
+unsigned int App::updateThreads {4};
+unsigned int App::updatePerSource {2};
+unsigned int App::updateInterval {360};
+unsigned int App::updateJitter {1000};
+
+unsigned int App::historyTail {1000};
+
+std::string App::logFile {};
+unsigned int App::logMaxSize {10};
+
 void App::initialize(int argc, char *argv[])
 {
   for (int i = 1; i < argc; i++) {
@@ -20,28 +78,161 @@ void App::initialize(int argc, char *argv[])
     } else if ((strcmp(argv[i], "--port") == 0 || strcmp(argv[i], "-p") == 0) && i + 1 < argc) {
       port = atoi(argv[i + 1]);
       i++;
+    } else if (strcmp(argv[i], "--local-threads") == 0 && i + 1 < argc) {
+      localThreads = std::max(1, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--local-queue") == 0 && i + 1 < argc) {
+      localQueue = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--remote-threads") == 0 && i + 1 < argc) {
+      remoteThreads = std::max(1, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--remote-queue") == 0 && i + 1 < argc) {
+      remoteQueue = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--extension-ttl") == 0 && i + 1 < argc) {
+      extensionTtl = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--isolate-extensions") == 0) {
+      isolateExtensions = true;
+    } else if (strcmp(argv[i], "--extension-workers") == 0 && i + 1 < argc) {
+      extensionWorkers = std::max(1, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--extension-cpu") == 0 && i + 1 < argc) {
+      extensionCpuLimit = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--extension-memory") == 0 && i + 1 < argc) {
+      extensionMemoryLimit = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--extension-timeout") == 0 && i + 1 < argc) {
+      extensionTimeout = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--http-prewarm") == 0 && i + 1 < argc) {
+      httpPrewarm = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--http-cache-size") == 0 && i + 1 < argc) {
+      httpCacheSize = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--http-cache-ttl") == 0 && i + 1 < argc) {
+      // host=seconds, for sources that send no caching headers
+      const std::string value {argv[i + 1]};
+      const auto separator = value.find('=');
+      if (separator != std::string::npos)
+        HttpCache::setTtl(value.substr(0, separator), atoi(value.c_str() + separator + 1));
+      i++;
+    } else if (strcmp(argv[i], "--http-record") == 0 && i + 1 < argc) {
+      httpRecord = argv[i + 1];
+      i++;
+    } else if (strcmp(argv[i], "--http-replay") == 0 && i + 1 < argc) {
+      httpReplay = argv[i + 1];
+      i++;
+    } else if (strcmp(argv[i], "--http-latency") == 0 && i + 1 < argc) {
+      httpLatency = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--http-jitter") == 0 && i + 1 < argc) {
+      httpJitter = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--image-cache-size") == 0 && i + 1 < argc) {
+      imageCacheSize = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--prefetch-threads") == 0 && i + 1 < argc) {
+      prefetchThreads = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--prefetch-chapters") == 0 && i + 1 < argc) {
+      prefetchChapters = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--prefetch-per-source") == 0 && i + 1 < argc) {
+      prefetchPerSource = std::max(1, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--prefetch-images") == 0 && i + 1 < argc) {
+      prefetchImages = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--search-threads") == 0 && i + 1 < argc) {
+      searchThreads = std::max(1, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--search-per-source") == 0 && i + 1 < argc) {
+      searchPerSource = std::max(1, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--download-threads") == 0 && i + 1 < argc) {
+      downloadThreads = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--download-per-source") == 0 && i + 1 < argc) {
+      downloadPerSource = std::max(1, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--update-threads") == 0 && i + 1 < argc) {
+      updateThreads = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--update-per-source") == 0 && i + 1 < argc) {
+      updatePerSource = std::max(1, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--update-interval") == 0 && i + 1 < argc) {
+      updateInterval = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--update-jitter") == 0 && i + 1 < argc) {
+      updateJitter = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--history-tail") == 0 && i + 1 < argc) {
+      historyTail = std::max(0, atoi(argv[i + 1]));
+      i++;
+    } else if (strcmp(argv[i], "--log-file") == 0 && i + 1 < argc) {
+      logFile = argv[i + 1];
+      i++;
+    } else if (strcmp(argv[i], "--log-max-size") == 0 && i + 1 < argc) {
+      logMaxSize = std::max(0, atoi(argv[i + 1]));
+      i++;
     }
   }
 
-  Http::init = &curl_easy_init;
-  Http::cleanup = &curl_easy_cleanup;
-  Http::setOpt = &curl_easy_setopt;
-  Http::perform = &curl_easy_perform;
-  Http::getInfo = &curl_easy_getinfo;
-  Http::slist_append = &curl_slist_append;
-  Http::slist_freeAll = &curl_slist_free_all;
-  Http::getError = &curl_easy_strerror;
+  if (!logFile.empty())
+    Log::setFile(logFile, static_cast<uint64_t>(logMaxSize) * 1024 * 1024);
+
+  HttpClient::initialize();
+  // Fixtures should see what the network returns, not the cache
+  if (!httpReplay.empty())
+    HttpFixture::initialize({HttpFixture::Mode::Replay, httpReplay, httpLatency, httpJitter});
+  else if (!httpRecord.empty())
+    HttpFixture::initialize({HttpFixture::Mode::Record, httpRecord});
+  else
+    HttpCache::initialize("cache/http", static_cast<uint64_t>(httpCacheSize) * 1024 * 1024);
+
+  Images::initialize("cache/images", static_cast<uint64_t>(imageCacheSize) * 1024 * 1024);
 
   Database::initialize();
-  manager = new Manager();
-  server = new Server(port);
+  std::optional<Sandbox::Options> isolation {};
+  if (isolateExtensions)
+    isolation = Sandbox::Options {extensionWorkers, extensionCpuLimit, extensionMemoryLimit, extensionTimeout};
+  manager = new Manager("extensions", isolation);
+  Prefetch::initialize({prefetchThreads, prefetchChapters, prefetchPerSource, prefetchImages});
+  Search::initialize({searchThreads, searchPerSource});
+  Downloads::initialize("downloads", {downloadThreads, downloadPerSource});
+  Updates::initialize({updateThreads, updatePerSource, updateInterval, updateJitter});
+  History::initialize(static_cast<int>(historyTail));
+  server = new Server(port, {localThreads, localQueue}, {remoteThreads, remoteQueue});
 
   new Api();
+  new Debug();
   new Web();
 }
 
 void App::start()
 {
   std::thread([]() { manager->updateExtensionIndexes(); }).detach();
+  if (extensionTtl > 0) {
+    std::thread([]() {
+      while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(std::min(extensionTtl, 60U)));
+        manager->unloadIdleExtensions(extensionTtl);
+      }
+    }).detach();
+  }
+  if (httpPrewarm > 0) {
+    // Servers drop idle connections after a minute or two
+    std::thread([]() {
+      while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(60));
+        HttpPool::prewarm(httpPrewarm);
+      }
+    }).detach();
+  }
   server->start();
 }
@@ -1,11 +1,79 @@
 #ifndef NONBIRI_APP_H_
 #define NONBIRI_APP_H_
 
+#include <string>
+
 namespace App
 {
 extern bool daemonize;
 extern int port;
 
+extern unsigned int localThreads;
+extern unsigned int localQueue;
+extern unsigned int remoteThreads;
+extern unsigned int remoteQueue;
+
+// Seconds an extension may stay unused before its library is unloaded
+extern unsigned int extensionTtl;
+
+// Runs extensions in worker processes instead of the server process
+extern bool isolateExtensions;
+extern unsigned int extensionWorkers;
+// CPU seconds per worker, 0 disables
+extern unsigned int extensionCpuLimit;
+// Megabytes per worker, 0 disables
+extern unsigned int extensionMemoryLimit;
+// Seconds per call, 0 disables
+extern unsigned int extensionTimeout;
+
+// Most used origins to keep a warm connection to, 0 disables
+extern unsigned int httpPrewarm;
+// Megabytes of outbound responses kept on disk, 0 disables
+extern unsigned int httpCacheSize;
+// Directory to record outbound requests to, or to replay them from
+extern std::string httpRecord;
+extern std::string httpReplay;
+// Milliseconds added to replayed responses, give or take httpJitter
+extern unsigned int httpLatency;
+extern unsigned int httpJitter;
+
+// Megabytes of page and cover images kept for /api/image
+extern unsigned int imageCacheSize;
+
+// Threads resolving the chapters after the one being read, 0 disables
+extern unsigned int prefetchThreads;
+extern unsigned int prefetchChapters;
+// Prefetches per source at once
+extern unsigned int prefetchPerSource;
+// Leading images of each prefetched chapter to store for /api/image
+extern unsigned int prefetchImages;
+
+// Threads searching sources for /api/search/all
+extern unsigned int searchThreads;
+// Searches per source at once
+extern unsigned int searchPerSource;
+
+// Threads downloading queued chapters for offline reading
+extern unsigned int downloadThreads;
+// Chapter downloads per source at once
+extern unsigned int downloadPerSource;
+
+// Threads checking library titles for new chapters
+extern unsigned int updateThreads;
+// Titles checked per source at once
+extern unsigned int updatePerSource;
+// Minutes between library update runs, 0 only runs them on request
+extern unsigned int updateInterval;
+// Milliseconds of random delay before each title is checked, at most
+extern unsigned int updateJitter;
+
+// History entries kept by the compactor besides the newest of each title
+extern unsigned int historyTail;
+
+extern std::string logFile;
+// Megabytes
+extern unsigned int logMaxSize;
+
 void initialize(int argc, char *argv[]);
 void start();
 }  // namespace App
@@ -1,5 +1,6 @@
 #include <nonbiri/cache.h>
 
-LRU<std::shared_ptr<Manga>> Cache::manga(256);
-LRU<std::shared_ptr<Chapter>> Cache::chapter(128);
-LRU<std::vector<std::shared_ptr<Chapter>>> Cache::chapters(8);
+LRU<std::shared_ptr<Manga>> Cache::manga("manga", 256);
+LRU<std::shared_ptr<Chapter>> Cache::chapter("chapter", 128);
+LRU<std::vector<std::shared_ptr<Chapter>>> Cache::chapters("chapters", 8);
+LRU<std::vector<std::string>> Cache::pages("pages", 64, Cache::pagesTtl);
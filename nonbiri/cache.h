@@ -2,6 +2,8 @@
 #define NONBIRI_CACHE_H_
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <nonbiri/lru.h>
 #include <nonbiri/models/manga.h>
@@ -11,6 +13,12 @@ namespace Cache
 extern LRU<std::shared_ptr<Manga>> manga;
 extern LRU<std::shared_ptr<Chapter>> chapter;
 extern LRU<std::vector<std::shared_ptr<Chapter>>> chapters;
+// Seconds a page list of a chapter outside the library is used for, image
+// URLs are often signed and expire
+constexpr unsigned int pagesTtl {30 * 60};
+// Page lists of chapters outside the library, those in it keep theirs
+// until an image fails to load
+extern LRU<std::vector<std::string>> pages;
 }  // namespace Cache
 
 #endif  // NONBIRI_CACHE_H_
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <nonbiri/cbz.h>
+
+namespace fs = std::filesystem;
+
+namespace Cbz
+{
+static constexpr uint32_t localSignature {0x04034b50};
+static constexpr uint32_t centralSignature {0x02014b50};
+static constexpr uint32_t endSignature {0x06054b50};
+// Version 2.0, the oldest that knows about directories
+static constexpr uint16_t version {20};
+static constexpr size_t localHeaderSize {30};
+static constexpr size_t centralHeaderSize {46};
+static constexpr size_t endSize {22};
+
+static uint32_t crc32(const std::string &data)
+{
+  static const auto table = [] {
+    std::array<uint32_t, 256> result {};
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t value = i;
+      for (int bit = 0; bit < 8; bit++)
+        value = value & 1 ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+      result[i] = value;
+    }
+    return result;
+  }();
+
+  uint32_t crc {0xFFFFFFFF};
+  for (const unsigned char c : data)
+    crc = table[(crc ^ c) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFF;
+}
+
+static void put16(std::string &out, uint16_t value)
+{
+  out += static_cast<char>(value & 0xFF);
+  out += static_cast<char>(value >> 8);
+}
+
+static void put32(std::string &out, uint32_t value)
+{
+  put16(out, static_cast<uint16_t>(value & 0xFFFF));
+  put16(out, static_cast<uint16_t>(value >> 16));
+}
+
+static uint16_t get16(const unsigned char *data)
+{
+  return static_cast<uint16_t>(data[0] | data[1] << 8);
+}
+
+static uint32_t get32(const unsigned char *data)
+{
+  return get16(data) | static_cast<uint32_t>(get16(data + 2)) << 16;
+}
+
+void write(const std::string &path, const std::vector<std::string> &files)
+{
+  const auto tmp = path + ".tmp";
+  std::ofstream archive(tmp, std::ios::binary | std::ios::trunc);
+  if (!archive.is_open())
+    throw std::runtime_error("Unable to create " + tmp);
+
+  std::string directory {};
+  uint64_t offset {};
+  for (const auto &file : files) {
+    std::ifstream input(file, std::ios::binary);
+    const std::string data {std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+    const std::string name {fs::path(file).filename().string()};
+    const uint32_t crc {crc32(data)};
+    if (offset + localHeaderSize + name.size() + data.size() > UINT32_MAX)
+      throw std::runtime_error("Chapter is too large for a zip archive");
+
+    // Stored, no timestamps, sizes known up front
+    std::string header {};
+    put32(header, localSignature);
+    put16(header, version);
+    put16(header, 0);
+    put16(header, 0);
+    put32(header, 0);
+    put32(header, crc);
+    put32(header, static_cast<uint32_t>(data.size()));
+    put32(header, static_cast<uint32_t>(data.size()));
+    put16(header, static_cast<uint16_t>(name.size()));
+    put16(header, 0);
+    header += name;
+    archive << header << data;
+
+    put32(directory, centralSignature);
+    put16(directory, version);
+    put16(directory, version);
+    put16(directory, 0);
+    put16(directory, 0);
+    put32(directory, 0);
+    put32(directory, crc);
+    put32(directory, static_cast<uint32_t>(data.size()));
+    put32(directory, static_cast<uint32_t>(data.size()));
+    put16(directory, static_cast<uint16_t>(name.size()));
+    put16(directory, 0);
+    put16(directory, 0);
+    put16(directory, 0);
+    put16(directory, 0);
+    put32(directory, 0);
+    put32(directory, static_cast<uint32_t>(offset));
+    directory += name;
+    offset += header.size() + data.size();
+  }
+
+  std::string end {};
+  put32(end, endSignature);
+  put16(end, 0);
+  put16(end, 0);
+  put16(end, static_cast<uint16_t>(files.size()));
+  put16(end, static_cast<uint16_t>(files.size()));
+  put32(end, static_cast<uint32_t>(directory.size()));
+  put32(end, static_cast<uint32_t>(offset));
+  put16(end, 0);
+  archive << directory << end;
+
+  archive.close();
+  if (!archive.good())
+    throw std::runtime_error("Unable to write " + tmp);
+  std::error_code error {};
+  fs::rename(tmp, path, error);
+  if (error)
+    throw std::runtime_error("Unable to write " + path + ": " + error.message());
+}
+
+std::vector<Entry> read(const char *data, size_t size)
+{
+  const auto *bytes = reinterpret_cast<const unsigned char *>(data);
+  if (size < endSize)
+    throw std::runtime_error("Not a zip archive");
+
+  // The end record sits last, followed only by a comment of up to 64 KiB
+  size_t end = size - endSize;
+  const size_t limit = end > 0xFFFF ? end - 0xFFFF : 0;
+  while (get32(bytes + end) != endSignature) {
+    if (end == limit)
+      throw std::runtime_error("Not a zip archive");
+    end--;
+  }
+
+  const uint16_t count = get16(bytes + end + 10);
+  size_t position = get32(bytes + end + 16);
+  std::vector<Entry> entries {};
+  for (uint16_t i = 0; i < count; i++) {
+    if (position + centralHeaderSize > size || get32(bytes + position) != centralSignature)
+      throw std::runtime_error("Corrupt zip archive");
+
+    const uint16_t method = get16(bytes + position + 10);
+    const uint32_t compressedSize = get32(bytes + position + 20);
+    const uint16_t nameSize = get16(bytes + position + 28);
+    const uint16_t extraSize = get16(bytes + position + 30);
+    const uint16_t commentSize = get16(bytes + position + 32);
+    const uint32_t localOffset = get32(bytes + position + 42);
+    if (position + centralHeaderSize + nameSize > size)
+      throw std::runtime_error("Corrupt zip archive");
+    std::string name(data + position + centralHeaderSize, nameSize);
+    position += centralHeaderSize + nameSize + extraSize + commentSize;
+
+    if (localOffset + localHeaderSize > size || get32(bytes + localOffset) != localSignature)
+      throw std::runtime_error("Corrupt zip archive");
+    // The local header may carry a different extra field than the central one
+    const uint64_t offset = localOffset + localHeaderSize + get16(bytes + localOffset + 26) + get16(bytes + localOffset + 28);
+    if (method != 0 || name.empty() || name.back() == '/' || offset + compressedSize > size)
+      continue;
+    entries.push_back({std::move(name), offset, compressedSize});
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.name < b.name; });
+  return entries;
+}
+}  // namespace Cbz
@@ -0,0 +1,29 @@
+#ifndef NONBIRI_CBZ_H_
+#define NONBIRI_CBZ_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Comic book archives: plain zip files holding one image per page. Pages
+// are stored uncompressed, as images do not compress any further, so a
+// page can be served straight out of the archive.
+namespace Cbz
+{
+struct Entry
+{
+  std::string name {};
+  // Where the page's bytes start within the archive
+  uint64_t offset {};
+  uint64_t size {};
+};
+
+// Packs files into an archive at path, each under its file name.
+void write(const std::string &path, const std::vector<std::string> &files);
+// Entries of an archive loaded or mapped into memory, sorted by name.
+// Compressed entries are left out, they cannot be served as they are.
+std::vector<Entry> read(const char *data, size_t size);
+}  // namespace Cbz
+
+#endif  // NONBIRI_CBZ_H_
@@ -1,17 +1,30 @@
 #include <algorithm>
-#include <iostream>
+#include <chrono>
+#include <condition_variable>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
-#include <core/filters.h>
-#include <core/prefs.h>
 #include <json/json.h>
 #include <nonbiri/controllers/api.h>
 #include <nonbiri/controllers/macro.h>
+#include <nonbiri/cache.h>
+#include <nonbiri/cbz.h>
+#include <nonbiri/covers.h>
+#include <nonbiri/downloads.h>
+#include <nonbiri/images.h>
+#include <nonbiri/log.h>
 #include <nonbiri/manager.h>
+#include <nonbiri/models/chapter.h>
+#include <nonbiri/models/history.h>
+#include <nonbiri/models/update.h>
+#include <nonbiri/prefetch.h>
+#include <nonbiri/search.h>
 #include <nonbiri/server.h>
+#include <nonbiri/updates.h>
 #include <nonbiri/utility.h>
 
 #define REQUIRE_PARAM(varName, name) \
@@ -23,6 +36,18 @@
 using httplib::Request;
 using httplib::Response;
 
+// Served straight from the mapped file. httplib answers Range requests from
+// the provider on its own and picks 200 or 206.
+static void serveImage(const Images::Image &image, Response &res)
+{
+  const auto mapping = image.mapping;
+  res.set_header("Accept-Ranges", "bytes");
+  res.set_header("Cache-Control", "public, max-age=604800");
+  res.set_content_provider(mapping->size(), image.contentType.c_str(), [mapping](size_t offset, size_t length, httplib::DataSink &sink) {
+    return sink.write(mapping->data() + offset, length);
+  });
+}
+
 Api::Api()
 {
   HTTP_GET("/api/extensions/filters/?", getExtensionFilters);
@@ -30,17 +55,30 @@ Api::Api()
   HTTP_POST("/api/extensions/prefs/?", setExtensionPrefs);
 
   HTTP_GET(R"(/api/extensions/?(\w+)?/?)", getExtensions);
-  HTTP_POST("/api/extensions/?", refreshExtensions);
-  HTTP_POST("/api/extensions/install/?", installExtension);
+  HTTP_POST_REMOTE("/api/extensions/?", refreshExtensions);
+  HTTP_POST_REMOTE("/api/extensions/install/?", installExtension);
   HTTP_POST("/api/extensions/uninstall/?", uninstallExtension);
-  HTTP_POST("/api/extensions/update/?", updateExtension);
-
-  HTTP_GET("/api/manga/?", getLatests);
-  HTTP_GET("/api/search/?", searchManga);
-  HTTP_GET("/api/metadata/?", getManga);
-  HTTP_GET("/api/chapters/?", getChapters);
-  HTTP_GET("/api/pages/?", getPages);
-  HTTP_POST("/api/library/manga/readState", setMangaReadState);
+  HTTP_POST_REMOTE("/api/extensions/update/?", updateExtension);
+
+  HTTP_GET_REMOTE("/api/manga/?", getLatests);
+  HTTP_GET_REMOTE("/api/search/all/?", searchAll);
+  HTTP_GET_REMOTE("/api/search/?", searchManga);
+  HTTP_GET_REMOTE("/api/metadata/?", getManga);
+  HTTP_GET_REMOTE("/api/chapters/?", getChapters);
+  HTTP_GET_REMOTE("/api/pages/?", getPages);
+  HTTP_GET_REMOTE("/api/image/?", getImage);
+  HTTP_GET_REMOTE("/api/cover/?", getCover);
+
+  HTTP_GET("/api/downloads/?", getDownloads);
+  HTTP_POST("/api/downloads/?", addDownload);
+  HTTP_DELETE("/api/downloads/?", removeDownload);
+  HTTP_GET("/api/downloads/page/?", getDownloadedPage);
+  HTTP_POST_REMOTE("/api/library/manga/readState", setMangaReadState);
+  HTTP_GET("/api/library/update/?", getLibraryUpdate);
+  HTTP_POST("/api/library/update/?", startLibraryUpdate);
+  HTTP_GET("/api/updates/?", getUpdates);
+  HTTP_GET("/api/history/?", getHistory);
+  HTTP_POST("/api/history/?", addHistory);
 }
 
 void Api::getExtensions(const Request &req, Response &res)
@@ -52,7 +90,7 @@ void Api::getExtensions(const Request &req, Response &res)
       res.headers.erase("refresh");
 
     Json::Value root {};
-    const auto &extensions = App::manager->getExtensions();
+    const auto extensions = App::manager->getExtensions();
 
     if (req.matches[1].str() == "index" || isRefresh) {
       const auto &indexes = App::manager->getIndexes();
@@ -62,10 +100,10 @@ void Api::getExtensions(const Request &req, Response &res)
         root.append(json);
       }
     } else {
-      for (const auto &ext : extensions) {
-        Json::Value json = ext.second->toJson();
-        json["hasUpdate"] = ext.second->hasUpdate.load();
-        json["hasPrefs"] = dynamic_cast<const Prefs *>(ext.second) != nullptr;
+      for (const auto &[domain, ext] : extensions) {
+        Json::Value json = ext.info.toJson();
+        json["hasUpdate"] = ext.hasUpdate;
+        json["hasPrefs"] = ext.hasPrefs;
         root.append(json);
       }
     }
@@ -73,7 +111,7 @@ void Api::getExtensions(const Request &req, Response &res)
     Json::FastWriter writer {};
     REPLY(200, root.empty() ? "[]" : writer.write(root), MIME_JSON);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -86,7 +124,7 @@ void Api::refreshExtensions(const Request &req, Response &res)
     res.set_header("refresh", "1");
     getExtensions(req, res);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -99,7 +137,7 @@ void Api::installExtension(const Request &req, Response &res)
     App::manager->downloadExtension(domain, false);
     getExtensions(req, res);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -112,7 +150,7 @@ void Api::uninstallExtension(const Request &req, Response &res)
     App::manager->removeExtension(domain);
     getExtensions(req, res);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -125,7 +163,7 @@ void Api::updateExtension(const Request &req, Response &res)
     App::manager->updateExtension(domain);
     getExtensions(req, res);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -135,28 +173,20 @@ void Api::getExtensionFilters(const httplib::Request &req, httplib::Response &re
   Utils::ExecTime execTime("Api::getExtensionFilters");
   try {
     REQUIRE_PARAM(domain, "domain");
-    Extension *ext = App::manager->getExtension(domain);
+    const auto ext = App::manager->getExtension(domain);
     if (ext == nullptr) {
       ABORT(404, JSON_EXTENSION_NOT_FOUND, MIME_JSON);
     }
 
-    auto filters = dynamic_cast<const Filters *>(ext);
-    if (filters == nullptr) {
+    const auto filters = App::manager->getFilters(*ext);
+    if (!filters) {
       ABORT(404, JSON_ERROR("Extension does not support filters"), MIME_JSON);
     }
 
-    Json::Value root {};
-    if (filters != nullptr) {
-      for (const auto &filter : filters->list()) {
-        if (dynamic_cast<const Filter::Hidden *>(filter.get()) == nullptr)
-          root.append(filter->toJson());
-      }
-    }
-
     Json::FastWriter writer {};
-    REPLY(200, root.empty() ? "[]" : writer.write(root), MIME_JSON);
+    REPLY(200, filters->empty() ? "[]" : writer.write(*filters), MIME_JSON);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -166,20 +196,20 @@ void Api::getExtensionPrefs(const httplib::Request &req, httplib::Response &res)
   Utils::ExecTime execTime("Api::getExtensionPrefs");
   try {
     REQUIRE_PARAM(domain, "domain");
-    Extension *ext = App::manager->getExtension(domain);
+    const auto ext = App::manager->getExtension(domain);
     if (ext == nullptr) {
       ABORT(404, JSON_EXTENSION_NOT_FOUND, MIME_JSON);
     }
 
-    auto prefs = dynamic_cast<const Prefs *>(ext);
-    if (prefs == nullptr) {
+    const auto prefs = App::manager->getPrefs(*ext);
+    if (!prefs) {
       ABORT(404, JSON_ERROR("Extension does not support preferences"), MIME_JSON);
     }
 
     Json::FastWriter writer {};
-    REPLY(200, writer.write(prefs->toJson()), MIME_JSON);
+    REPLY(200, writer.write(*prefs), MIME_JSON);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -189,31 +219,29 @@ void Api::setExtensionPrefs(const httplib::Request &req, httplib::Response &res)
   Utils::ExecTime execTime("Api::setExtensionPrefs");
   try {
     REQUIRE_PARAM(domain, "domain");
-    Extension *ext = App::manager->getExtension(domain);
+    const auto ext = App::manager->getExtension(domain);
     if (ext == nullptr) {
       ABORT(404, JSON_EXTENSION_NOT_FOUND, MIME_JSON);
     }
 
-    auto prefs = dynamic_cast<Prefs *>(ext);
-    if (prefs == nullptr) {
-      ABORT(404, JSON_ERROR("Extension does not support preferences"), MIME_JSON);
-    }
-
     Json::Reader reader {};
     Json::Value payload {};
     if (!reader.parse(req.body, payload)) {
       ABORT(400, JSON_ERROR("Unable to parse payload"), MIME_JSON);
     }
 
-    prefs->update(payload);
+    const auto prefs = App::manager->setPrefs(*ext, payload);
+    if (!prefs) {
+      ABORT(404, JSON_ERROR("Extension does not support preferences"), MIME_JSON);
+    }
 
     Json::Value root {};
-    root["new"] = prefs->toJson();
+    root["new"] = *prefs;
 
     Json::FastWriter writer {};
     REPLY(200, writer.write(root), MIME_JSON);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -225,7 +253,7 @@ void Api::getLatests(const Request &req, Response &res)
     REQUIRE_PARAM(domain, "domain");
     REQUIRE_PARAM(sPage, "page");
 
-    Extension *ext = App::manager->getExtension(domain);
+    const auto ext = App::manager->getExtension(domain);
     if (ext == nullptr) {
       ABORT(404, JSON_EXTENSION_NOT_FOUND, MIME_JSON);
     }
@@ -242,7 +270,7 @@ void Api::getLatests(const Request &req, Response &res)
     Json::FastWriter writer {};
     REPLY(200, writer.write(root), MIME_JSON);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -252,13 +280,13 @@ void Api::searchManga(const Request &req, Response &res)
   Utils::ExecTime execTime("Api::searchManga");
   try {
     REQUIRE_PARAM(domain, "domain");
-    Extension *ext = App::manager->getExtension(domain);
+    const auto ext = App::manager->getExtension(domain);
     if (ext == nullptr) {
       ABORT(404, JSON_EXTENSION_NOT_FOUND, MIME_JSON);
     }
 
-    auto filters = dynamic_cast<const Filters *>(ext);
-    if (filters == nullptr) {
+    const auto filterKeys = App::manager->getFilterKeys(*ext);
+    if (!filterKeys) {
       ABORT(404, JSON_ERROR("Extension does not support filters"), MIME_JSON);
     }
 
@@ -266,13 +294,12 @@ void Api::searchManga(const Request &req, Response &res)
     std::string query {};
     std::vector<std::pair<std::string, std::string>> pairs {};
 
-    const auto &index = filters->index();
     for (const auto &[key, value] : req.params) {
       if (key == "page") {
         page = std::max(1, std::stoi(value));
       } else if (key == "q") {
         query = value;
-      } else if (index.find(key) != index.end()) {
+      } else if (filterKeys->count(key) > 0) {
         pairs.push_back({key, value});
       }
     }
@@ -288,7 +315,198 @@ void Api::searchManga(const Request &req, Response &res)
     Json::FastWriter writer {};
     REPLY(200, writer.write(root), MIME_JSON);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
+    REPLY(500, JSON_EXCEPTION, MIME_JSON);
+  }
+}
+
+// Shared between a search/all response and the searches it started, which
+// may outlive the response if a source misses its deadline.
+struct SearchAll
+{
+  using Clock = std::chrono::steady_clock;
+
+  std::mutex mutex {};
+  std::condition_variable cv {};
+  // Sources without a line yet, by when they have to finish
+  std::map<std::string, Clock::time_point> pending {};
+  std::vector<std::string> lines {};
+  std::chrono::seconds timeout {};
+  Clock::time_point startedAt {Clock::now()};
+  bool isClosed {};
+  size_t failed {};
+
+  static double millisSince(Clock::time_point start)
+  {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  // Gives domain its own timeout from now on, false if it ran out waiting
+  // for a worker or the response already ended
+  bool begin(const std::string &domain)
+  {
+    std::lock_guard lock(mutex);
+    const auto it = pending.find(domain);
+    if (isClosed || it == pending.end())
+      return false;
+    it->second = Clock::now() + timeout;
+    cv.notify_one();
+    return true;
+  }
+
+  // Hands the line of domain to the response, unless it already ended or
+  // the source ran out of time
+  void finish(const std::string &domain, const Json::Value &root)
+  {
+    Json::FastWriter writer {};
+    const auto line = writer.write(root);
+
+    std::lock_guard lock(mutex);
+    if (isClosed || pending.erase(domain) == 0)
+      return;
+    lines.push_back(line);
+    if (root.isMember("error"))
+      failed++;
+    cv.notify_one();
+  }
+
+  // Ends the sources past their deadline with an error line. Returns when
+  // the next one is due.
+  Clock::time_point expire()
+  {
+    const auto now = Clock::now();
+    auto next = Clock::time_point::max();
+    for (auto it = pending.begin(); it != pending.end();) {
+      if (it->second > now) {
+        next = std::min(next, it->second);
+        it++;
+        continue;
+      }
+      Json::Value root {};
+      root["domain"] = it->first;
+      root["error"] = "Deadline exceeded";
+      root["elapsed"] = millisSince(startedAt);
+
+      Json::FastWriter writer {};
+      lines.push_back(writer.write(root));
+      failed++;
+      it = pending.erase(it);
+    }
+    return next;
+  }
+};
+
+void Api::searchAll(const Request &req, Response &res)
+{
+  Utils::ExecTime execTime("Api::searchAll");
+  try {
+    REQUIRE_PARAM(query, "q");
+
+    int page {1};
+    if (req.has_param("page"))
+      page = std::max(1, std::stoi(req.get_param_value("page")));
+
+    int timeout {10};
+    if (req.has_param("timeout"))
+      timeout = std::clamp(std::stoi(req.get_param_value("timeout")), 1, 60);
+
+    const auto state = std::make_shared<SearchAll>();
+    state->timeout = std::chrono::seconds(timeout);
+
+    std::vector<std::string> domains {};
+    for (const auto &[domain, installed] : App::manager->getExtensions()) {
+      if (installed.hasFilters)
+        domains.push_back(domain);
+    }
+    // Each source has timeout seconds to get a worker, then as long again
+    // from when its search starts
+    for (const auto &domain : domains)
+      state->pending[domain] = state->startedAt + state->timeout;
+
+    // Sources are searched on the search workers, a slow one only delays its
+    // own line. Searches still queued when the response ends are skipped.
+    for (const auto &domain : domains) {
+      const bool isQueued = Search::enqueue(domain, [state, domain, page, query] {
+        if (!state->begin(domain))
+          return;
+
+        const auto start = SearchAll::Clock::now();
+        Json::Value root {};
+        root["domain"] = domain;
+        try {
+          const auto ext = App::manager->getExtension(domain);
+          if (ext == nullptr)
+            throw std::runtime_error("Extension not found");
+
+          const auto &[entries, hasNext] = App::manager->searchManga(*ext, page, query, {});
+          root["page"] = page;
+          root["hasNext"] = hasNext;
+          root["entries"] = Json::arrayValue;
+          for (const auto &manga : entries)
+            root["entries"].append(manga->toJson());
+        } catch (const std::exception &e) {
+          root["error"] = e.what();
+        }
+
+        root["elapsed"] = SearchAll::millisSince(start);
+        state->finish(domain, root);
+      });
+
+      if (!isQueued) {
+        Json::Value root {};
+        root["domain"] = domain;
+        root["error"] = "Server is busy";
+        root["elapsed"] = SearchAll::millisSince(state->startedAt);
+        state->finish(domain, root);
+      }
+    }
+
+    // One JSON object per line, per source as it finishes, then a summary.
+    // The remote lane slot stays taken until the stream ends, the searches
+    // run on behalf of this request until then.
+    const auto slot = Server::holdSlot();
+    const auto release = [state, slot](bool) {
+      std::lock_guard lock(state->mutex);
+      state->isClosed = true;
+    };
+    res.set_chunked_content_provider("application/x-ndjson", [state, sources = domains.size()](size_t, httplib::DataSink &sink) {
+      std::vector<std::string> lines {};
+      bool isDone {};
+      {
+        std::unique_lock lock(state->mutex);
+        // A search that starts moves its deadline and wakes this up
+        while (state->lines.empty() && !state->pending.empty()) {
+          const auto next = state->expire();
+          if (state->lines.empty() && !state->pending.empty())
+            state->cv.wait_until(lock, next);
+        }
+        lines.swap(state->lines);
+
+        if (state->pending.empty()) {
+          Json::Value summary {};
+          summary["done"] = true;
+          summary["sources"] = static_cast<Json::UInt64>(sources);
+          summary["failed"] = static_cast<Json::UInt64>(state->failed);
+
+          summary["elapsed"] = SearchAll::millisSince(state->startedAt);
+
+          Json::FastWriter writer {};
+          lines.push_back(writer.write(summary));
+          state->isClosed = true;
+          isDone = true;
+        }
+      }
+
+      for (const auto &line : lines) {
+        if (!sink.write(line.data(), line.size()))
+          return false;
+      }
+      if (isDone)
+        sink.done();
+      return true;
+    }, release);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -300,7 +518,7 @@ void Api::getManga(const Request &req, Response &res)
     REQUIRE_PARAM(domain, "domain");
     REQUIRE_PARAM(path, "path");
 
-    Extension *ext = App::manager->getExtension(domain);
+    const auto ext = App::manager->getExtension(domain);
     if (ext == nullptr) {
       ABORT(404, JSON_EXTENSION_NOT_FOUND, MIME_JSON);
     }
@@ -314,7 +532,7 @@ void Api::getManga(const Request &req, Response &res)
     Json::FastWriter writer {};
     REPLY(200, writer.write(root), MIME_JSON);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -326,21 +544,46 @@ void Api::getChapters(const Request &req, Response &res)
     REQUIRE_PARAM(domain, "domain");
     REQUIRE_PARAM(path, "path");
 
-    Extension *ext = App::manager->getExtension(domain);
+    const auto ext = App::manager->getExtension(domain);
     if (ext == nullptr) {
       ABORT(404, JSON_EXTENSION_NOT_FOUND, MIME_JSON);
     }
 
-    const auto chapters = App::manager->getChapters(*ext, path);
+    const auto manga = App::manager->getManga(*ext, path);
+    if (manga == nullptr) {
+      ABORT(404, JSON_MANGA_NOT_FOUND, MIME_JSON);
+    }
+
+    // Taken before the chapters are read, a change in between is sent again
+    // on the next sync rather than missed
+    const int64_t cursor = Chapter::lastChange();
+    const int64_t since = req.has_param("since") ? std::stoll(req.get_param_value("since")) : 0;
 
     Json::Value root {};
     Json::FastWriter writer {};
-    for (const auto &chapter : chapters)
-      root["entries"].append(chapter->toJson());
+    root["cursor"] = cursor;
+    root["entries"] = Json::Value(Json::arrayValue);
+
+    // Only library chapters are tracked, the others always come in full
+    if (since > 0 && manga->id > 0) {
+      root["isDelta"] = true;
+      for (const auto &chapter : Chapter::findChanged(manga->id, since))
+        root["entries"].append(chapter->toJson());
+      REPLY(200, writer.write(root), MIME_JSON);
+      return;
+    }
+
+    // offset and limit slice the list for views that render part of it
+    const auto chapters = App::manager->getChapters(*ext, *manga);
+    const size_t offset = req.has_param("offset") ? std::min<size_t>(std::stoul(req.get_param_value("offset")), chapters.size()) : 0;
+    const size_t limit = req.has_param("limit") ? std::stoul(req.get_param_value("limit")) : chapters.size();
+    root["total"] = static_cast<Json::UInt64>(chapters.size());
+    for (size_t i = offset; i < chapters.size() && i - offset < limit; i++)
+      root["entries"].append(chapters[i]->toJson());
 
     REPLY(200, writer.write(root), MIME_JSON);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -352,21 +595,178 @@ void Api::getPages(const Request &req, Response &res)
     REQUIRE_PARAM(domain, "domain");
     REQUIRE_PARAM(path, "path");
 
-    Extension *ext = App::manager->getExtension(domain);
+    const auto ext = App::manager->getExtension(domain);
     if (ext == nullptr) {
       ABORT(404, JSON_EXTENSION_NOT_FOUND, MIME_JSON);
     }
 
-    const auto pages = App::manager->getPages(*ext, path);
+    // Downloaded chapters are read from their archive, the source is not asked
+    std::vector<std::string> pages {};
+    if (const auto chapter = Chapter::find(domain, path); chapter != nullptr && chapter->isDownloaded)
+      pages = Downloads::pagesOf(*chapter);
+
+    // Sent by the reader when the stored page URLs stop loading
+    const bool refresh = req.has_param("refresh") && req.get_param_value("refresh") != "0";
+    const bool isArchived = !pages.empty();
+    if (!isArchived)
+      pages = App::manager->getPages(*ext, path, refresh);
+    // Chapters outside the library are only found through their manga. One
+    // read from its archive leaves the source alone.
+    if (!isArchived && !pages.empty())
+      Prefetch::schedule(domain, path, req.has_param("manga") ? req.get_param_value("manga") : "");
 
     Json::Value root {};
     Json::FastWriter writer {};
-    for (const auto &page : pages)
+    for (const auto &page : pages) {
+      Images::allow(domain, page);
       root["pages"].append(page);
+    }
+
+    REPLY(200, writer.write(root), MIME_JSON);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error: " << e.what());
+    REPLY(500, JSON_EXCEPTION, MIME_JSON);
+  }
+}
+
+void Api::getImage(const Request &req, Response &res)
+{
+  Utils::ExecTime execTime("Api::getImage");
+  try {
+    REQUIRE_PARAM(domain, "domain");
+    REQUIRE_PARAM(url, "url");
+
+    // Only images of installed sources are proxied
+    const auto ext = App::manager->getExtension(domain);
+    if (ext == nullptr) {
+      ABORT(404, JSON_EXTENSION_NOT_FOUND, MIME_JSON);
+    }
+    if (!Images::isAllowed(domain, ext->baseUrl, url)) {
+      ABORT(403, JSON_ERROR("Image host not allowed"), MIME_JSON);
+    }
+
+    serveImage(Images::fetch(url, ext->baseUrl.empty() ? "" : ext->baseUrl + "/"), res);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error: " << e.what());
+    REPLY(500, JSON_EXCEPTION, MIME_JSON);
+  }
+}
+
+void Api::getCover(const Request &req, Response &res)
+{
+  Utils::ExecTime execTime("Api::getCover");
+  try {
+    REQUIRE_PARAM(domain, "domain");
+    REQUIRE_PARAM(url, "url");
+    REQUIRE_PARAM(width, "width");
+
+    const auto ext = App::manager->getExtension(domain);
+    if (ext == nullptr) {
+      ABORT(404, JSON_EXTENSION_NOT_FOUND, MIME_JSON);
+    }
+    if (!Images::isAllowed(domain, ext->baseUrl, url)) {
+      ABORT(403, JSON_ERROR("Image host not allowed"), MIME_JSON);
+    }
 
+    int size {};
+    try {
+      size = std::stoi(width);
+    } catch (const std::exception &) {
+      ABORT(400, JSON_ERROR("Invalid width"), MIME_JSON);
+    }
+
+    serveImage(Covers::get(url, std::max(1, size), ext->baseUrl.empty() ? "" : ext->baseUrl + "/"), res);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error: " << e.what());
+    REPLY(500, JSON_EXCEPTION, MIME_JSON);
+  }
+}
+
+void Api::getDownloads(const Request &req, Response &res)
+{
+  Utils::ExecTime execTime("Api::getDownloads");
+  try {
+    Json::Value root {};
+    Json::FastWriter writer {};
+    root["entries"] = Downloads::status();
     REPLY(200, writer.write(root), MIME_JSON);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
+    REPLY(500, JSON_EXCEPTION, MIME_JSON);
+  }
+}
+
+void Api::addDownload(const Request &req, Response &res)
+{
+  Utils::ExecTime execTime("Api::addDownload");
+  try {
+    REQUIRE_PARAM(domain, "domain");
+    REQUIRE_PARAM(path, "path");
+
+    // Only library chapters have a row to mark as downloaded
+    const auto chapter = Chapter::find(domain, path);
+    if (chapter == nullptr) {
+      ABORT(404, JSON_ERROR("Chapter not found"), MIME_JSON);
+    }
+
+    Downloads::enqueue(*chapter);
+    Json::FastWriter writer {};
+    REPLY(202, writer.write(chapter->toJson()), MIME_JSON);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error: " << e.what());
+    REPLY(500, JSON_EXCEPTION, MIME_JSON);
+  }
+}
+
+void Api::removeDownload(const Request &req, Response &res)
+{
+  Utils::ExecTime execTime("Api::removeDownload");
+  try {
+    REQUIRE_PARAM(domain, "domain");
+    REQUIRE_PARAM(path, "path");
+
+    const auto chapter = Chapter::find(domain, path);
+    if (chapter == nullptr) {
+      ABORT(404, JSON_ERROR("Chapter not found"), MIME_JSON);
+    }
+
+    Downloads::remove(*chapter);
+    Json::FastWriter writer {};
+    REPLY(200, writer.write(chapter->toJson()), MIME_JSON);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error: " << e.what());
+    REPLY(500, JSON_EXCEPTION, MIME_JSON);
+  }
+}
+
+void Api::getDownloadedPage(const Request &req, Response &res)
+{
+  Utils::ExecTime execTime("Api::getDownloadedPage");
+  try {
+    REQUIRE_PARAM(id, "id");
+    REQUIRE_PARAM(page, "page");
+
+    const auto chapter = Chapter::find(std::stoll(id));
+    if (chapter == nullptr || !chapter->isDownloaded) {
+      ABORT(404, JSON_ERROR("Chapter not downloaded"), MIME_JSON);
+    }
+
+    // The page is a slice of the mapped archive, nothing is extracted
+    const auto mapping = std::make_shared<Images::Mapping>(Downloads::archiveOf(*chapter));
+    const auto entries = Cbz::read(mapping->data(), mapping->size());
+    const size_t index = std::stoul(page);
+    if (index >= entries.size()) {
+      ABORT(404, JSON_ERROR("Page not found"), MIME_JSON);
+    }
+
+    const auto entry = entries[index];
+    res.set_header("Accept-Ranges", "bytes");
+    res.set_header("Cache-Control", "private, max-age=604800");
+    res.set_content_provider(entry.size, Downloads::contentTypeOf(entry.name).c_str(), [mapping, entry](size_t offset, size_t length, httplib::DataSink &sink) {
+      return sink.write(mapping->data() + entry.offset + offset, length);
+    });
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
 }
@@ -379,7 +779,7 @@ void Api::setMangaReadState(const Request &req, Response &res)
     REQUIRE_PARAM(path, "path");
     REQUIRE_PARAM(sState, "state");
 
-    Extension *ext = App::manager->getExtension(domain);
+    const auto ext = App::manager->getExtension(domain);
     if (ext == nullptr) {
       ABORT(404, JSON_EXTENSION_NOT_FOUND, MIME_JSON);
     }
@@ -402,7 +802,134 @@ void Api::setMangaReadState(const Request &req, Response &res)
     Json::FastWriter writer {};
     REPLY(200, writer.write(manga->toJson()), MIME_JSON);
   } catch (const std::exception &e) {
-    std::cerr << "Error: " << e.what() << std::endl;
+    LOG_ERROR("Error: " << e.what());
+    REPLY(500, JSON_EXCEPTION, MIME_JSON);
+  }
+}
+
+void Api::getLibraryUpdate(const Request &req, Response &res)
+{
+  Utils::ExecTime execTime("Api::getLibraryUpdate");
+  try {
+    Json::FastWriter writer {};
+    REPLY(200, writer.write(Updates::status()), MIME_JSON);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error: " << e.what());
     REPLY(500, JSON_EXCEPTION, MIME_JSON);
   }
-}
\ No newline at end of file
+}
+
+void Api::startLibraryUpdate(const Request &req, Response &res)
+{
+  Utils::ExecTime execTime("Api::startLibraryUpdate");
+  try {
+    // A run still going is reported as it is rather than started over
+    const bool isStarted = Updates::start();
+    Json::FastWriter writer {};
+    REPLY(isStarted ? 202 : 200, writer.write(Updates::status()), MIME_JSON);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error: " << e.what());
+    REPLY(500, JSON_EXCEPTION, MIME_JSON);
+  }
+}
+
+void Api::getUpdates(const Request &req, Response &res)
+{
+  Utils::ExecTime execTime("Api::getUpdates");
+  try {
+    // cursor is the id of the last entry of the previous page
+    const int64_t cursor = req.has_param("cursor") ? std::stoll(req.get_param_value("cursor")) : 0;
+    const int limit = req.has_param("limit") ? std::clamp(std::stoi(req.get_param_value("limit")), 1, 100) : 50;
+    const auto updates = Update::findAll(cursor, limit);
+
+    Json::Value root {};
+    Json::FastWriter writer {};
+    root["entries"] = Json::Value(Json::arrayValue);
+    for (const auto &update : updates)
+      root["entries"].append(update->toJson());
+    if (updates.size() == static_cast<size_t>(limit))
+      root["cursor"] = updates.back()->id;
+
+    REPLY(200, writer.write(root), MIME_JSON);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error: " << e.what());
+    REPLY(500, JSON_EXCEPTION, MIME_JSON);
+  }
+}
+
+void Api::getHistory(const Request &req, Response &res)
+{
+  Utils::ExecTime execTime("Api::getHistory");
+  try {
+    // cursor is the id of the last entry of the previous page
+    const int64_t cursor = req.has_param("cursor") ? std::stoll(req.get_param_value("cursor")) : 0;
+    const int limit = req.has_param("limit") ? std::clamp(std::stoi(req.get_param_value("limit")), 1, 100) : 50;
+    const auto history = History::findAll(cursor, limit);
+
+    Json::Value root {};
+    Json::FastWriter writer {};
+    root["entries"] = Json::Value(Json::arrayValue);
+    for (const auto &entry : history)
+      root["entries"].append(entry->toJson());
+    if (history.size() == static_cast<size_t>(limit))
+      root["cursor"] = history.back()->id;
+
+    REPLY(200, writer.write(root), MIME_JSON);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error: " << e.what());
+    REPLY(500, JSON_EXCEPTION, MIME_JSON);
+  }
+}
+
+void Api::addHistory(const Request &req, Response &res)
+{
+  Utils::ExecTime execTime("Api::addHistory");
+  try {
+    REQUIRE_PARAM(domain, "domain");
+    REQUIRE_PARAM(path, "path");
+    REQUIRE_PARAM(mangaPath, "manga");
+    int page {};
+    try {
+      page = req.has_param("page") ? std::max(0, std::stoi(req.get_param_value("page"))) : 0;
+    } catch (const std::exception &) {
+      ABORT(400, JSON_ERROR("Invalid page"), MIME_JSON);
+    }
+
+    // Never asks the source. Titles in the library or opened a moment ago
+    // are known already, for the rest the reader passes along what it shows.
+    // Covers are only taken from those, every cover listed is one the image
+    // proxy agrees to fetch.
+    History entry {};
+    entry.domain = domain;
+    entry.mangaPath = mangaPath;
+    entry.mangaTitle = req.get_param_value("title");
+    entry.chapterPath = path;
+    entry.chapterName = req.get_param_value("name");
+    entry.page = page;
+
+    auto manga = Manga::find(domain, mangaPath);
+    if (manga == nullptr)
+      manga = Cache::manga.get(domain + mangaPath);
+    if (manga != nullptr) {
+      entry.mangaTitle = manga->title;
+      entry.coverUrl = manga->customCoverUrl.empty() ? manga->coverUrl : manga->customCoverUrl;
+    }
+
+    if (const auto chapter = Chapter::find(domain, path); chapter != nullptr) {
+      entry.chapterName = chapter->name;
+      chapter->setRead(page);
+    } else {
+      const auto chapters = Cache::chapters.get(domain + mangaPath);
+      const auto it = std::find_if(chapters.begin(), chapters.end(), [&](const auto &c) { return c->path == path; });
+      if (it != chapters.end())
+        entry.chapterName = (*it)->name;
+    }
+    entry.save();
+
+    Json::FastWriter writer {};
+    REPLY(200, writer.write(entry.toJson()), MIME_JSON);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Error: " << e.what());
+    REPLY(500, JSON_EXCEPTION, MIME_JSON);
+  }
+}
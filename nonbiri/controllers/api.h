@@ -20,11 +20,24 @@ public:
 
   void getLatests(const httplib::Request &, httplib::Response &);
   void searchManga(const httplib::Request &, httplib::Response &);
+  void searchAll(const httplib::Request &, httplib::Response &);
   void getManga(const httplib::Request &, httplib::Response &);
   void getChapters(const httplib::Request &, httplib::Response &);
   void getPages(const httplib::Request &, httplib::Response &);
+  void getImage(const httplib::Request &, httplib::Response &);
+  void getCover(const httplib::Request &, httplib::Response &);
+
+  void getDownloads(const httplib::Request &, httplib::Response &);
+  void addDownload(const httplib::Request &, httplib::Response &);
+  void removeDownload(const httplib::Request &, httplib::Response &);
+  void getDownloadedPage(const httplib::Request &, httplib::Response &);
 
   void setMangaReadState(const httplib::Request &, httplib::Response &);
+  void getLibraryUpdate(const httplib::Request &, httplib::Response &);
+  void startLibraryUpdate(const httplib::Request &, httplib::Response &);
+  void getUpdates(const httplib::Request &, httplib::Response &);
+  void getHistory(const httplib::Request &, httplib::Response &);
+  void addHistory(const httplib::Request &, httplib::Response &);
 };
 
 #endif  // NONBIRI_CONTROLLERS_API_H_
\ No newline at end of file
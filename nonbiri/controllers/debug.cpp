@@ -0,0 +1,31 @@
+#include <nonbiri/controllers/debug.h>
+#include <nonbiri/controllers/macro.h>
+#include <nonbiri/metrics.h>
+#include <nonbiri/server.h>
+#include <nonbiri/trace.h>
+
+using httplib::Request;
+using httplib::Response;
+
+Debug::Debug()
+{
+  HTTP_GET("/metrics/?", metrics);
+  HTTP_GET("/debug/trace/?", getTrace);
+  HTTP_DELETE("/debug/trace/?", clearTrace);
+}
+
+void Debug::metrics(const Request &, Response &res)
+{
+  REPLY(200, Metrics::render(), "text/plain; version=0.0.4");
+}
+
+void Debug::getTrace(const Request &, Response &res)
+{
+  REPLY(200, Trace::render(), MIME_JSON);
+}
+
+void Debug::clearTrace(const Request &, Response &res)
+{
+  Trace::clear();
+  res.status = 204;
+}
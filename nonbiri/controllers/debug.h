@@ -0,0 +1,16 @@
+#ifndef NONBIRI_CONTROLLERS_DEBUG_H_
+#define NONBIRI_CONTROLLERS_DEBUG_H_
+
+#include <httplib.h>
+
+class Debug
+{
+public:
+  Debug();
+
+  void metrics(const httplib::Request &, httplib::Response &);
+  void getTrace(const httplib::Request &, httplib::Response &);
+  void clearTrace(const httplib::Request &, httplib::Response &);
+};
+
+#endif  // NONBIRI_CONTROLLERS_DEBUG_H_
@@ -18,8 +18,14 @@
   res.status = code; \
   return res.set_content(body, mime);
 
-#define HTTP_GET(path, callback)    App::server->Get(path, [&](const Request &req, Response &res) { callback(req, res); })
-#define HTTP_POST(path, callback)   App::server->Post(path, [&](const Request &req, Response &res) { callback(req, res); })
-#define HTTP_DELETE(path, callback) App::server->Delete(path, [&](const Request &req, Response &res) { callback(req, res); })
+#define HTTP_HANDLER(callback) [&](const Request &req, Response &res) { callback(req, res); }
+
+#define HTTP_GET(path, callback)    App::server->Get(path, Server::Lane::Local, HTTP_HANDLER(callback))
+#define HTTP_POST(path, callback)   App::server->Post(path, Server::Lane::Local, HTTP_HANDLER(callback))
+#define HTTP_DELETE(path, callback) App::server->Delete(path, Server::Lane::Local, HTTP_HANDLER(callback))
+
+#define HTTP_GET_REMOTE(path, callback)    App::server->Get(path, Server::Lane::Remote, HTTP_HANDLER(callback))
+#define HTTP_POST_REMOTE(path, callback)   App::server->Post(path, Server::Lane::Remote, HTTP_HANDLER(callback))
+#define HTTP_DELETE_REMOTE(path, callback) App::server->Delete(path, Server::Lane::Remote, HTTP_HANDLER(callback))
 
 #endif  // NONBIRI_CONTROLLERS_MACRO_H_
\ No newline at end of file
@@ -13,7 +13,7 @@ namespace fs = std::filesystem;
 
 Web::Web()
 {
-  HTTP_GET(R"(/icons/(\S+)/(\S+)?)", icon);
+  HTTP_GET_REMOTE(R"(/icons/(\S+)/(\S+)?)", icon);
   HTTP_GET("/?(history|updates|browse)?/?.*", render);
   App::server->set_mount_point("/assets", "./assets");
 }
@@ -33,7 +33,7 @@ void Web::icon(const Request &req, Response &res)
   const std::string fileName = domain + "-" + version + ".png";
   const std::string path = (fs::path("icons") / fileName).string();
 
-  if (!fs::exists(path) && App::manager->getExtensionInfo(domain) == nullptr) {
+  if (!fs::exists(path) && !App::manager->getExtensionInfo(domain)) {
     res.status = 404;
     return;
   }
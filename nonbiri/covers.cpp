@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <cmath>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <jpeglib.h>
+#include <png.h>
+
+#include <nonbiri/covers.h>
+#include <nonbiri/lru.h>
+#include <nonbiri/metrics.h>
+
+namespace Covers
+{
+// Larger images are served as they are rather than decoded
+static constexpr uint64_t maxPixels {64 * 1024 * 1024};
+// PNGs cannot be decoded scaled down, the full image is held at 3 bytes a
+// pixel, 24 MiB at most
+static constexpr uint64_t maxPngPixels {8 * 1024 * 1024};
+static constexpr int quality {80};
+
+struct Bitmap
+{
+  unsigned int width {};
+  unsigned int height {};
+  // RGB, rows packed without padding
+  std::vector<uint8_t> pixels {};
+};
+
+// Source pixels making up one destination pixel
+struct Span
+{
+  unsigned int first {};
+  // 1/256ths, adding up to 256
+  std::vector<uint16_t> weights {};
+};
+
+struct JpegError
+{
+  jpeg_error_mgr manager {};
+  jmp_buf jump {};
+};
+
+static void onJpegError(j_common_ptr info)
+{
+  longjmp(reinterpret_cast<JpegError *>(info->err)->jump, 1);
+}
+
+static std::string encode(const std::string &value)
+{
+  static constexpr char hex[] {"0123456789ABCDEF"};
+  std::string result {};
+  for (const unsigned char c : value) {
+    if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+      result += c;
+    } else {
+      result += '%';
+      result += hex[c >> 4];
+      result += hex[c & 15];
+    }
+  }
+  return result;
+}
+
+static std::string hashOf(const char *data, size_t size)
+{
+  uint64_t hash {14695981039346656037ULL};
+  for (size_t i = 0; i < size; i++)
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * 1099511628211ULL;
+  char result[17] {};
+  snprintf(result, sizeof(result), "%016llx", static_cast<unsigned long long>(hash));
+  return result;
+}
+
+// Decodes at the smallest of 1/1, 1/2, 1/4 or 1/8 scale that is still at
+// least width wide, which libjpeg does for a fraction of the full cost.
+// Images no wider than width are left undecoded with empty pixels.
+static bool decodeJpeg(const char *data, size_t size, unsigned int width, Bitmap &bitmap)
+{
+  jpeg_decompress_struct info {};
+  JpegError error {};
+  info.err = jpeg_std_error(&error.manager);
+  error.manager.error_exit = onJpegError;
+  if (setjmp(error.jump)) {
+    jpeg_destroy_decompress(&info);
+    return false;
+  }
+
+  jpeg_create_decompress(&info);
+  jpeg_mem_src(&info, reinterpret_cast<unsigned char *>(const_cast<char *>(data)), size);
+  jpeg_read_header(&info, TRUE);
+  if (info.image_width <= width || static_cast<uint64_t>(info.image_width) * info.image_height > maxPixels) {
+    bitmap.width = info.image_width;
+    jpeg_destroy_decompress(&info);
+    return info.image_width <= width;
+  }
+
+  info.out_color_space = JCS_RGB;
+  info.scale_num = 1;
+  info.scale_denom = 1;
+  while (info.scale_denom < 8 && info.image_width / (info.scale_denom * 2) >= width)
+    info.scale_denom *= 2;
+
+  jpeg_start_decompress(&info);
+  bitmap.width = info.output_width;
+  bitmap.height = info.output_height;
+  bitmap.pixels.resize(static_cast<size_t>(bitmap.width) * bitmap.height * 3);
+  while (info.output_scanline < info.output_height) {
+    JSAMPROW row = &bitmap.pixels[static_cast<size_t>(info.output_scanline) * bitmap.width * 3];
+    jpeg_read_scanlines(&info, &row, 1);
+  }
+  jpeg_finish_decompress(&info);
+  jpeg_destroy_decompress(&info);
+  return true;
+}
+
+// Transparent areas end up white, the thumbnails are JPEG
+static bool decodePng(const char *data, size_t size, unsigned int width, Bitmap &bitmap)
+{
+  png_image image {};
+  image.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_memory(&image, data, size))
+    return false;
+  if (image.width <= width || static_cast<uint64_t>(image.width) * image.height > maxPngPixels) {
+    bitmap.width = image.width;
+    png_image_free(&image);
+    return image.width <= width;
+  }
+
+  image.format = PNG_FORMAT_RGB;
+  bitmap.width = image.width;
+  bitmap.height = image.height;
+  bitmap.pixels.resize(PNG_IMAGE_SIZE(image));
+  png_color background {255, 255, 255};
+  if (!png_image_finish_read(&image, &background, bitmap.pixels.data(), 0, nullptr)) {
+    png_image_free(&image);
+    bitmap.pixels.clear();
+    return false;
+  }
+  return true;
+}
+
+static std::string encodeJpeg(const Bitmap &bitmap)
+{
+  jpeg_compress_struct info {};
+  JpegError error {};
+  unsigned char *buffer {};
+  unsigned long size {};
+  info.err = jpeg_std_error(&error.manager);
+  error.manager.error_exit = onJpegError;
+  if (setjmp(error.jump)) {
+    jpeg_destroy_compress(&info);
+    free(buffer);
+    return {};
+  }
+
+  jpeg_create_compress(&info);
+  jpeg_mem_dest(&info, &buffer, &size);
+  info.image_width = bitmap.width;
+  info.image_height = bitmap.height;
+  info.input_components = 3;
+  info.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&info);
+  jpeg_set_quality(&info, quality, TRUE);
+  info.optimize_coding = TRUE;
+
+  jpeg_start_compress(&info, TRUE);
+  while (info.next_scanline < info.image_height) {
+    JSAMPROW row = const_cast<JSAMPROW>(&bitmap.pixels[static_cast<size_t>(info.next_scanline) * bitmap.width * 3]);
+    jpeg_write_scanlines(&info, &row, 1);
+  }
+  jpeg_finish_compress(&info);
+  jpeg_destroy_compress(&info);
+
+  std::string result(reinterpret_cast<const char *>(buffer), size);
+  free(buffer);
+  return result;
+}
+
+// Area averaging: each destination pixel is the mean of the source pixels
+// it covers, weighted by how much of each it covers.
+static std::vector<Span> spansOf(unsigned int from, unsigned int to)
+{
+  std::vector<Span> spans(to);
+  const double scale = static_cast<double>(from) / to;
+  for (unsigned int i = 0; i < to; i++) {
+    const double begin = i * scale;
+    const double end = (i + 1) * scale;
+    auto &span = spans[i];
+    span.first = static_cast<unsigned int>(begin);
+    const unsigned int last = std::min(from, static_cast<unsigned int>(std::ceil(end)));
+
+    int total {};
+    for (unsigned int j = span.first; j < last; j++) {
+      const double overlap = std::min<double>(j + 1, end) - std::max<double>(j, begin);
+      span.weights.push_back(static_cast<uint16_t>(std::lround(overlap / scale * 256)));
+      total += span.weights.back();
+    }
+    // Rounding leaves the sum a little off, the largest weight absorbs it
+    auto &largest = *std::max_element(span.weights.begin(), span.weights.end());
+    largest = static_cast<uint16_t>(largest + 256 - total);
+  }
+  return spans;
+}
+
+// Two separable passes in 8.8 fixed point. The vertical one runs over
+// whole rows, so its inner loop is a plain multiply-add the compiler
+// vectorizes.
+static Bitmap resize(const Bitmap &from, unsigned int width)
+{
+  Bitmap to {};
+  to.width = width;
+  to.height = std::max(1U, static_cast<unsigned int>(std::lround(static_cast<double>(from.height) * width / from.width)));
+  const auto columns = spansOf(from.width, to.width);
+  const auto rows = spansOf(from.height, to.height);
+  const size_t stride = static_cast<size_t>(to.width) * 3;
+
+  std::vector<uint8_t> narrow(stride * from.height);
+  for (unsigned int y = 0; y < from.height; y++) {
+    const uint8_t *source = &from.pixels[static_cast<size_t>(y) * from.width * 3];
+    uint8_t *target = &narrow[y * stride];
+    for (unsigned int x = 0; x < to.width; x++) {
+      const auto &span = columns[x];
+      uint32_t sums[3] {};
+      for (size_t k = 0; k < span.weights.size(); k++) {
+        const uint8_t *pixel = source + (span.first + k) * 3;
+        sums[0] += span.weights[k] * pixel[0];
+        sums[1] += span.weights[k] * pixel[1];
+        sums[2] += span.weights[k] * pixel[2];
+      }
+      for (int c = 0; c < 3; c++)
+        target[x * 3 + c] = static_cast<uint8_t>((sums[c] + 128) >> 8);
+    }
+  }
+
+  to.pixels.resize(stride * to.height);
+  std::vector<uint32_t> sums(stride);
+  for (unsigned int y = 0; y < to.height; y++) {
+    const auto &span = rows[y];
+    std::fill(sums.begin(), sums.end(), 0);
+    for (size_t k = 0; k < span.weights.size(); k++) {
+      const uint8_t *source = &narrow[(span.first + k) * stride];
+      const uint32_t weight = span.weights[k];
+      for (size_t i = 0; i < stride; i++)
+        sums[i] += weight * source[i];
+    }
+    uint8_t *target = &to.pixels[y * stride];
+    for (size_t i = 0; i < stride; i++)
+      target[i] = static_cast<uint8_t>((sums[i] + 128) >> 8);
+  }
+  return to;
+}
+
+std::string urlOf(const std::string &domain, const std::string &coverUrl, unsigned int width)
+{
+  // A cover handed out is one the proxy has to serve
+  Images::allow(domain, coverUrl);
+  return "/api/cover?domain=" + encode(domain) + "&url=" + encode(coverUrl) + "&width=" + std::to_string(width);
+}
+
+Images::Image get(const std::string &url, unsigned int width, const std::string &referer)
+{
+  const auto target = std::find_if(std::begin(widths), std::end(widths), [&](unsigned int w) { return w >= width; });
+  if (target == std::end(widths))
+    return Images::fetch(url, referer);
+  width = *target;
+
+  // Spares hashing the cover again while its thumbnails are stored
+  static LRU<std::string> hashes("cover_hashes", 4096);
+  static auto &generated = Metrics::counter("nonbiri_cover_thumbnails_total");
+  auto hash = hashes.get(url);
+  if (!hash.empty()) {
+    if (const auto thumbnail = Images::find(hash + "@" + std::to_string(width)))
+      return *thumbnail;
+  }
+
+  const auto original = Images::fetch(url, referer);
+  const Images::Mapping &mapping = *original.mapping;
+  if (hash.empty()) {
+    hash = hashOf(mapping.data(), mapping.size());
+    hashes.set(url, hash);
+  }
+
+  const auto key = hash + "@" + std::to_string(width);
+  if (const auto thumbnail = Images::find(key))
+    return *thumbnail;
+
+  const auto *bytes = reinterpret_cast<const unsigned char *>(mapping.data());
+  const bool isJpeg = mapping.size() > 3 && bytes[0] == 0xFF && bytes[1] == 0xD8 && bytes[2] == 0xFF;
+  const bool isPng = mapping.size() > 8 && png_sig_cmp(bytes, 0, 8) == 0;
+
+  Bitmap bitmap {};
+  if (isJpeg && !decodeJpeg(mapping.data(), mapping.size(), width, bitmap))
+    return original;
+  if (isPng && !decodePng(mapping.data(), mapping.size(), width, bitmap))
+    return original;
+  if (bitmap.pixels.empty())
+    return original;
+
+  const auto data = encodeJpeg(resize(bitmap, width));
+  if (data.empty() || data.size() >= original.size)
+    return original;
+  generated.increment();
+  return Images::put(key, "image/jpeg", data);
+}
+}  // namespace Covers
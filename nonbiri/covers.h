@@ -0,0 +1,25 @@
+#ifndef NONBIRI_COVERS_H_
+#define NONBIRI_COVERS_H_
+
+#include <string>
+
+#include <nonbiri/images.h>
+
+// Downscaled copies of manga covers for browse grids, which show them far
+// smaller than sources serve them. Each cover is downloaded once into the
+// image store, and its thumbnails are stored there under the hash of the
+// cover's bytes, so the same cover behind different URLs is scaled once.
+namespace Covers
+{
+// Widths thumbnails are made in, requests are rounded up to one of them
+inline constexpr unsigned int widths[] {160, 320, 640};
+
+// Link to the thumbnail of coverUrl served by /api/cover
+std::string urlOf(const std::string &domain, const std::string &coverUrl, unsigned int width);
+
+// Thumbnail of url at least width pixels wide. Covers that are already
+// small enough, or in a format that cannot be decoded, are returned as is.
+Images::Image get(const std::string &url, unsigned int width, const std::string &referer = "");
+}  // namespace Covers
+
+#endif  // NONBIRI_COVERS_H_
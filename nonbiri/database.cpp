@@ -1,9 +1,9 @@
 #include <fstream>
-#include <iostream>
 #include <sstream>
 #include <stdexcept>
 
 #include <nonbiri/database.h>
+#include <nonbiri/log.h>
 #include <nonbiri/utility.h>
 
 sqlite3 *Database::instance = nullptr;
@@ -34,13 +34,13 @@ void Database::Tx::rollback()
   isRolledBack = true;
 }
 
-void Database::initialize()
+void Database::initialize(const std::string &path)
 {
   if (instance != nullptr)
     return;
 
-  std::cout << "Initializing database..." << std::endl;
-  int exit = sqlite3_open("nonbiri.db", &instance);
+  LOG_INFO("Initializing database...");
+  int exit = sqlite3_open(path.c_str(), &instance);
   if (exit != SQLITE_OK)
     throw std::runtime_error(sqlite3_errmsg(instance));
 
@@ -25,7 +25,9 @@ public:
 
 extern sqlite3 *instance;
 
-void initialize();
+// Opens the database at path and applies nonbiri.sql from the working
+// directory to it.
+void initialize(const std::string &path = "nonbiri.db");
 std::vector<std::string> deserializeArray(const std::string &str);
 std::string serializeArray(const std::vector<std::string> &array);
 }  // namespace Database
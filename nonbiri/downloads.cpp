@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+
+#include <nonbiri/cbz.h>
+#include <nonbiri/downloads.h>
+#include <nonbiri/images.h>
+#include <nonbiri/log.h>
+#include <nonbiri/manager.h>
+#include <nonbiri/metrics.h>
+#include <nonbiri/models/download.h>
+#include <nonbiri/pool.h>
+
+namespace fs = std::filesystem;
+
+namespace Downloads
+{
+struct Job
+{
+  int64_t chapterId {};
+  std::string domain {};
+};
+
+struct Progress
+{
+  size_t done {};
+  size_t total {};
+};
+
+static const std::pair<const char *, const char *> types[] {
+  {"image/jpeg", ".jpg"},
+  {"image/png", ".png"},
+  {"image/webp", ".webp"},
+  {"image/gif", ".gif"},
+  {"image/avif", ".avif"},
+};
+
+static std::string root {};
+static Options options {};
+// Its mutex guards progress and cancelled as well
+static SourcePool<Job> pool {};
+static std::map<int64_t, Progress> progress {};
+// Removed while being downloaded, their worker stops at the next page
+static std::set<int64_t> cancelled {};
+
+static Metrics::Counter &chaptersCounter(const std::string &result)
+{
+  return Metrics::counter("nonbiri_download_chapters_total", {{"result", result}});
+}
+
+static std::string extensionOf(const std::string &contentType)
+{
+  for (const auto &[type, extension] : types) {
+    if (contentType.rfind(type, 0) == 0)
+      return extension;
+  }
+  return ".img";
+}
+
+static fs::path partialOf(int64_t chapterId)
+{
+  return fs::path(root) / ".partial" / std::to_string(chapterId);
+}
+
+static bool isCancelled(int64_t chapterId)
+{
+  std::lock_guard lock(pool.mutex);
+  return cancelled.find(chapterId) != cancelled.end();
+}
+
+static void setProgress(int64_t chapterId, size_t done, size_t total)
+{
+  std::lock_guard lock(pool.mutex);
+  progress[chapterId] = {done, total};
+}
+
+// Downloads a page to base plus the extension its content type calls for.
+// Pages already in the image store are copied from there.
+static fs::path fetchPage(const std::string &url, const fs::path &base, const std::string &referer)
+{
+  static auto &pages = Metrics::counter("nonbiri_download_pages_total");
+  if (const auto stored = Images::find(url)) {
+    const auto path = fs::path(base.string() + extensionOf(stored->contentType));
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(stored->mapping->data(), static_cast<std::streamsize>(stored->mapping->size()));
+    if (!file.good())
+      throw std::runtime_error("Unable to write " + path.string());
+    return path;
+  }
+
+  const auto tmp = base.string() + ".download";
+  const auto contentType = Images::save(url, tmp, referer);
+  const auto path = fs::path(base.string() + extensionOf(contentType));
+  fs::rename(tmp, path);
+  pages.increment();
+  return path;
+}
+
+// Pages kept by an earlier attempt, by name without extension
+static std::map<std::string, fs::path> existingPages(const fs::path &dir)
+{
+  std::map<std::string, fs::path> pages {};
+  std::error_code error {};
+  for (const auto &file : fs::directory_iterator(dir, error)) {
+    const auto extension = file.path().extension().string();
+    if (extension != ".download" && extension != ".tmp")
+      pages[file.path().stem().string()] = file.path();
+  }
+  return pages;
+}
+
+// Returns false when the chapter was cancelled before it was done
+static bool download(const Job &job)
+{
+  const auto chapter = Chapter::find(job.chapterId);
+  if (chapter == nullptr) {
+    Download::remove(job.chapterId);
+    return false;
+  }
+
+  const auto ext = App::manager->getExtension(chapter->domain);
+  if (ext == nullptr)
+    throw std::runtime_error("Extension not found");
+  const std::string referer {ext->baseUrl.empty() ? "" : ext->baseUrl + "/"};
+
+  const auto partial = partialOf(chapter->id);
+  fs::create_directories(partial);
+  auto pages = App::manager->getPages(*ext, chapter->path);
+  if (pages.empty())
+    throw std::runtime_error("Chapter has no pages");
+
+  const auto existing = existingPages(partial);
+  const size_t digits = std::max<size_t>(3, std::to_string(pages.size()).size());
+  std::vector<std::string> files {};
+  bool isRefreshed {};
+  for (size_t i = 0; i < pages.size(); i++) {
+    if (isCancelled(chapter->id))
+      return false;
+    setProgress(chapter->id, i, pages.size());
+
+    std::string name {std::to_string(i + 1)};
+    name.insert(0, digits - name.size(), '0');
+    const auto it = existing.find(name);
+    if (it != existing.end()) {
+      files.push_back(it->second.string());
+      continue;
+    }
+
+    try {
+      files.push_back(fetchPage(pages[i], partial / name, referer).string());
+    } catch (const std::exception &) {
+      // Stored page URLs may have expired, a fresh list is worth one retry
+      if (isRefreshed)
+        throw;
+      isRefreshed = true;
+      const auto size = pages.size();
+      pages = App::manager->getPages(*ext, chapter->path, true);
+      if (pages.size() != size) {
+        fs::remove_all(partial);
+        throw std::runtime_error("Chapter changed while downloading, retry it");
+      }
+      files.push_back(fetchPage(pages[i], partial / name, referer).string());
+    }
+  }
+
+  if (isCancelled(chapter->id))
+    return false;
+  const auto archive = archiveOf(*chapter);
+  fs::create_directories(fs::path(archive).parent_path());
+  Cbz::write(archive, files);
+
+  // Checked and marked together, so a removal either lands before and the
+  // archive goes, or after and finds the chapter downloaded and not running
+  bool isDone {};
+  {
+    std::lock_guard lock(pool.mutex);
+    isDone = cancelled.find(chapter->id) == cancelled.end();
+    if (isDone) {
+      chapter->setDownloaded(true);
+      progress.erase(chapter->id);
+    }
+  }
+
+  std::error_code error {};
+  if (!isDone) {
+    fs::remove(archive, error);
+    return false;
+  }
+  Download::remove(chapter->id);
+  fs::remove_all(partial, error);
+  return true;
+}
+
+static void run(Job &job)
+{
+  try {
+    if (download(job)) {
+      chaptersCounter("done").increment();
+    } else {
+      chaptersCounter("cancelled").increment();
+      std::error_code error {};
+      fs::remove_all(partialOf(job.chapterId), error);
+    }
+  } catch (const std::exception &e) {
+    chaptersCounter("failed").increment();
+    LOG_ERROR("Unable to download chapter " << job.chapterId << ": " << e.what());
+    try {
+      Download::fail(job.chapterId, e.what());
+    } catch (const std::exception &error) {
+      LOG_ERROR("Unable to record download error: " << error.what());
+    }
+  }
+
+  std::lock_guard lock(pool.mutex);
+  progress.erase(job.chapterId);
+  cancelled.erase(job.chapterId);
+}
+
+// Marked as running in the same lock that takes it off the queue, so
+// enqueue() always finds it in one of the two
+static void take(Job &job)
+{
+  progress[job.chapterId] = {};
+}
+
+void initialize(const std::string &dir, const Options &opts)
+{
+  root = dir;
+  options = opts;
+  fs::create_directories(fs::path(root) / ".partial");
+
+  {
+    std::lock_guard lock(pool.mutex);
+    for (const auto &download : Download::findAll())
+      pool.queue.push_back({download->chapterId, download->domain});
+    if (!pool.queue.empty())
+      LOG_INFO("Resuming " << pool.queue.size() << " chapter downloads");
+  }
+  pool.start(options.threads, options.perSource, {run, take});
+}
+
+void enqueue(const Chapter &chapter)
+{
+  if (chapter.id <= 0)
+    throw std::runtime_error("Only chapters in the library can be downloaded");
+
+  Download::add(chapter.id);
+  {
+    std::lock_guard lock(pool.mutex);
+    cancelled.erase(chapter.id);
+    auto &queue = pool.queue;
+    const bool isQueued = std::any_of(queue.begin(), queue.end(), [&](const Job &job) { return job.chapterId == chapter.id; });
+    if (isQueued || progress.find(chapter.id) != progress.end())
+      return;
+    queue.push_back({chapter.id, chapter.domain});
+  }
+  pool.notify();
+}
+
+void remove(Chapter &chapter)
+{
+  Download::remove(chapter.id);
+  bool isRunning {};
+  {
+    std::lock_guard lock(pool.mutex);
+    auto &queue = pool.queue;
+    queue.erase(std::remove_if(queue.begin(), queue.end(), [&](const Job &job) { return job.chapterId == chapter.id; }), queue.end());
+    isRunning = progress.find(chapter.id) != progress.end();
+    if (isRunning)
+      cancelled.insert(chapter.id);
+  }
+
+  std::error_code error {};
+  if (!isRunning)
+    fs::remove_all(partialOf(chapter.id), error);
+  // A download may have finished since chapter was loaded
+  if (chapter.isDownloaded || !isRunning) {
+    fs::remove(archiveOf(chapter), error);
+    chapter.setDownloaded(false);
+  }
+}
+
+Json::Value status()
+{
+  Json::Value root(Json::arrayValue);
+  for (const auto &download : Download::findAll()) {
+    auto json = download->toJson();
+    std::lock_guard lock(pool.mutex);
+    const auto it = progress.find(download->chapterId);
+    json["isRunning"] = it != progress.end();
+    if (it != progress.end()) {
+      json["done"] = static_cast<Json::UInt64>(it->second.done);
+      json["total"] = static_cast<Json::UInt64>(it->second.total);
+    }
+    root.append(json);
+  }
+  return root;
+}
+
+std::string archiveOf(const Chapter &chapter)
+{
+  return (fs::path(root) / chapter.domain / (std::to_string(chapter.id) + ".cbz")).string();
+}
+
+std::vector<std::string> pagesOf(const Chapter &chapter)
+{
+  std::error_code error {};
+  if (!chapter.isDownloaded || !fs::exists(archiveOf(chapter), error))
+    return {};
+
+  const Images::Mapping mapping(archiveOf(chapter));
+  const auto entries = Cbz::read(mapping.data(), mapping.size());
+  std::vector<std::string> pages {};
+  for (size_t i = 0; i < entries.size(); i++)
+    pages.push_back("/api/downloads/page?id=" + std::to_string(chapter.id) + "&page=" + std::to_string(i));
+  return pages;
+}
+
+std::string contentTypeOf(const std::string &name)
+{
+  const auto extension = fs::path(name).extension().string();
+  for (const auto &[type, ext] : types) {
+    if (extension == ext)
+      return type;
+  }
+  return "application/octet-stream";
+}
+}  // namespace Downloads
@@ -0,0 +1,37 @@
+#ifndef NONBIRI_DOWNLOADS_H_
+#define NONBIRI_DOWNLOADS_H_
+
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+#include <nonbiri/models/chapter.h>
+
+// Downloads library chapters for offline reading, one CBZ archive per
+// chapter. The queue lives in the database and pages are kept as they
+// arrive, so a restart resumes chapters instead of starting them over.
+namespace Downloads
+{
+struct Options
+{
+  unsigned int threads {};
+  // Chapters allowed to download from one source at once
+  unsigned int perSource {};
+};
+
+// Picks up the queue left by the last run and starts working through it.
+void initialize(const std::string &dir, const Options &options);
+
+void enqueue(const Chapter &chapter);
+// Takes the chapter out of the queue, or deletes its archive if it is done
+void remove(Chapter &chapter);
+// The queue with the progress of the chapters being downloaded
+Json::Value status();
+
+std::string archiveOf(const Chapter &chapter);
+// Links to the pages of a downloaded chapter, served from its archive
+std::vector<std::string> pagesOf(const Chapter &chapter);
+std::string contentTypeOf(const std::string &name);
+}  // namespace Downloads
+
+#endif  // NONBIRI_DOWNLOADS_H_
@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <vector>
+
+#include <json/json.h>
+#include <nonbiri/http/cache.h>
+#include <nonbiri/http/engine.h>
+#include <nonbiri/http/pool.h>
+#include <nonbiri/http/shim.h>
+#include <nonbiri/log.h>
+#include <nonbiri/metrics.h>
+
+namespace fs = std::filesystem;
+
+namespace HttpCache
+{
+// Larger responses are passed through without being stored
+static constexpr size_t maxEntrySize {8 * 1024 * 1024};
+// Upper bound for the Last-Modified heuristic
+static constexpr time_t maxHeuristicTtl {24 * 60 * 60};
+
+using HttpShim::Capture;
+using HttpShim::headerOf;
+using HttpShim::Request;
+using HttpShim::writeBody;
+using HttpShim::writeHeaders;
+
+struct Entry
+{
+  std::string file {};
+  uint64_t size {};
+  time_t storedAt {};
+  time_t ttl {};
+  std::string etag {};
+  std::string lastModified {};
+  time_t lastUsed {};
+};
+
+// A stored response, read back from disk
+struct Response
+{
+  long status {};
+  std::string contentType {};
+  std::vector<std::string> headers {};
+  std::string body {};
+};
+
+struct Store
+{
+  std::mutex mutex {};
+  bool isEnabled {};
+  std::string dir {};
+  uint64_t maxSize {};
+  uint64_t size {};
+  std::map<std::string, Entry> entries {};
+  std::map<std::string, time_t> ttls {};
+
+  HttpShim::Requests requests {};
+};
+
+static Store &store()
+{
+  static Store instance {};
+  return instance;
+}
+
+static Metrics::Counter &requestsCounter(const std::string &result)
+{
+  return Metrics::counter("nonbiri_http_cache_requests_total", {{"result", result}});
+}
+
+static std::string lower(std::string value)
+{
+  std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+  return value;
+}
+
+static std::string trim(const std::string &value)
+{
+  const auto begin = value.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos)
+    return {};
+  return value.substr(begin, value.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+static std::string hostOf(const std::string &url)
+{
+  const auto scheme = url.find("://");
+  const auto begin = scheme == std::string::npos ? 0 : scheme + 3;
+  const auto end = url.find_first_of(":/?#", begin);
+  return lower(url.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+}
+
+static time_t parseDate(const std::string &value)
+{
+  return value.empty() ? -1 : curl_getdate(value.c_str(), nullptr);
+}
+
+// Freshness lifetime of a response, or -1 if it must not be stored.
+static time_t ttlOf(const std::vector<std::string> &headers, const std::string &url, time_t now)
+{
+  const auto vary = lower(headerOf(headers, "vary"));
+  if (!vary.empty() && vary != "accept-encoding")
+    return -1;
+
+  time_t ttl {-1};
+  std::stringstream directives(lower(headerOf(headers, "cache-control")));
+  for (std::string directive {}; std::getline(directives, directive, ',');) {
+    directive = trim(directive);
+    if (directive == "no-store")
+      return -1;
+    if (directive == "no-cache")
+      ttl = 0;
+    else if (directive.rfind("max-age=", 0) == 0 && ttl != 0)
+      ttl = std::max(static_cast<time_t>(0), static_cast<time_t>(atoll(directive.c_str() + 8)));
+  }
+
+  const time_t date = std::max(parseDate(headerOf(headers, "date")), static_cast<time_t>(0));
+  if (ttl < 0) {
+    const time_t expires = parseDate(headerOf(headers, "expires"));
+    if (expires >= 0)
+      ttl = std::max(static_cast<time_t>(0), expires - (date > 0 ? date : now));
+  }
+
+  if (ttl < 0) {
+    auto &s = store();
+    const auto host = hostOf(url);
+    std::lock_guard lock(s.mutex);
+    for (const auto &[domain, override] : s.ttls) {
+      if (host == domain || (host.size() > domain.size() && host.ends_with("." + domain)))
+        ttl = override;
+    }
+  }
+
+  if (ttl < 0) {
+    const time_t lastModified = parseDate(headerOf(headers, "last-modified"));
+    if (lastModified >= 0)
+      ttl = std::min(((date > 0 ? date : now) - lastModified) / 10, maxHeuristicTtl);
+  }
+
+  const time_t age = atoll(headerOf(headers, "age").c_str());
+  return std::max(static_cast<time_t>(0), ttl - age);
+}
+
+static std::string fileOf(const std::string &url)
+{
+  char name[17] {};
+  snprintf(name, sizeof(name), "%016zx", std::hash<std::string> {}(url));
+  return name;
+}
+
+static bool readResponse(const std::string &path, const std::string &url, Response &response)
+{
+  Json::Value meta {};
+  if (!HttpShim::readResponse(path, meta, response.body) || meta["url"].asString() != url)
+    return false;
+
+  response.status = meta["status"].asInt();
+  response.contentType = meta["contentType"].asString();
+  for (const auto &header : meta["headers"])
+    response.headers.push_back(header.asString());
+  return true;
+}
+
+static Json::Value metaOf(const std::string &url, const Entry &entry, const Response &response)
+{
+  Json::Value meta {};
+  meta["url"] = url;
+  meta["status"] = static_cast<Json::Int>(response.status);
+  meta["contentType"] = response.contentType;
+  meta["storedAt"] = static_cast<Json::Int64>(entry.storedAt);
+  meta["ttl"] = static_cast<Json::Int64>(entry.ttl);
+  meta["etag"] = entry.etag;
+  meta["lastModified"] = entry.lastModified;
+  meta["headers"] = Json::arrayValue;
+  for (const auto &header : response.headers)
+    meta["headers"].append(header);
+  return meta;
+}
+
+static void writeResponse(const std::string &url, Entry entry, const Response &response)
+{
+  auto &s = store();
+  entry.file = fileOf(url);
+  entry.size = response.body.size();
+  entry.lastUsed = entry.storedAt;
+
+  const auto path = fs::path(s.dir) / entry.file;
+  if (!HttpShim::writeResponse(path.string(), metaOf(url, entry, response), response.body))
+    return;
+
+  static auto &evictions = Metrics::counter("nonbiri_http_cache_evictions_total");
+  std::vector<std::string> evicted {};
+  {
+    std::lock_guard lock(s.mutex);
+    auto it = s.entries.find(url);
+    if (it != s.entries.end())
+      s.size -= it->second.size;
+    s.entries[url] = entry;
+    s.size += entry.size;
+
+    while (s.size > s.maxSize && !s.entries.empty()) {
+      auto oldest = std::min_element(s.entries.begin(), s.entries.end(), [](const auto &a, const auto &b) {
+        return a.second.lastUsed < b.second.lastUsed;
+      });
+      s.size -= oldest->second.size;
+      evicted.push_back(oldest->second.file);
+      s.entries.erase(oldest);
+      evictions.increment();
+    }
+  }
+
+  std::error_code error {};
+  for (const auto &file : evicted)
+    fs::remove(fs::path(s.dir) / file, error);
+}
+
+static bool isBypassed(const curl_slist *headers)
+{
+  for (auto header = headers; header != nullptr; header = header->next) {
+    const auto line = lower(header->data);
+    if ((line.rfind("cache-control:", 0) == 0 && (line.find("no-cache") != std::string::npos || line.find("no-store") != std::string::npos))
+        || line.rfind("pragma:", 0) == 0)
+      return true;
+  }
+  return false;
+}
+
+void initialize(const std::string &dir, uint64_t maxSize)
+{
+  auto &s = store();
+  std::lock_guard lock(s.mutex);
+  s.dir = dir;
+  s.maxSize = maxSize;
+  s.isEnabled = maxSize > 0;
+  if (!s.isEnabled)
+    return;
+
+  std::error_code error {};
+  fs::create_directories(dir, error);
+  for (const auto &file : fs::directory_iterator(dir, error)) {
+    const auto path = file.path();
+    if (path.extension() == ".tmp") {
+      fs::remove(path, error);
+      continue;
+    }
+
+    std::ifstream stream(path, std::ios::binary);
+    std::string line {};
+    Json::Value meta {};
+    Json::Reader reader {};
+    if (!std::getline(stream, line) || !reader.parse(line, meta)) {
+      fs::remove(path, error);
+      continue;
+    }
+
+    Entry entry {};
+    entry.file = path.filename().string();
+    entry.size = file.file_size(error);
+    entry.storedAt = meta["storedAt"].asInt64();
+    entry.ttl = meta["ttl"].asInt64();
+    entry.etag = meta["etag"].asString();
+    entry.lastModified = meta["lastModified"].asString();
+    entry.lastUsed = entry.storedAt;
+
+    s.entries[meta["url"].asString()] = entry;
+    s.size += entry.size;
+  }
+
+  LOG_INFO("HTTP cache holds " << s.entries.size() << " responses (" << s.size / 1024 << " KiB)");
+}
+
+void setTtl(const std::string &host, time_t ttl)
+{
+  auto &s = store();
+  std::lock_guard lock(s.mutex);
+  s.ttls[lower(host)] = ttl;
+}
+
+CURLcode setOpt(CURL *handle, CURLoption option, ...)
+{
+  va_list args {};
+  va_start(args, option);
+  const CURLcode code = store().requests.setOpt(curl_easy_setopt, handle, option, args);
+  va_end(args);
+  return code;
+}
+
+CURLcode getInfo(CURL *handle, CURLINFO info, ...)
+{
+  va_list args {};
+  va_start(args, info);
+  const CURLcode code = store().requests.getInfo(curl_easy_getinfo, handle, info, args);
+  va_end(args);
+  return code;
+}
+
+CURLcode perform(CURL *handle)
+{
+  static auto &hits = requestsCounter("hit");
+  static auto &revalidated = requestsCounter("revalidated");
+  static auto &misses = requestsCounter("miss");
+  static auto &bypassed = requestsCounter("bypass");
+
+  auto &s = store();
+  Request *request {&s.requests.of(handle)};
+  request->status = 0;
+
+  bool isEnabled {};
+  {
+    std::lock_guard lock(s.mutex);
+    isEnabled = s.isEnabled;
+  }
+
+  if (!isEnabled || !request->isCacheable || request->url.empty() || isBypassed(request->headers)) {
+    if (isEnabled)
+      bypassed.increment();
+    return HttpEngine::perform(handle);
+  }
+
+  const time_t now {time(nullptr)};
+  std::optional<Entry> entry {};
+  {
+    std::lock_guard lock(s.mutex);
+    auto it = s.entries.find(request->url);
+    if (it != s.entries.end()) {
+      it->second.lastUsed = now;
+      entry = it->second;
+    }
+  }
+
+  Response cached {};
+  if (entry.has_value() && !readResponse((fs::path(s.dir) / entry->file).string(), request->url, cached))
+    entry.reset();
+
+  if (entry.has_value() && now < entry->storedAt + entry->ttl) {
+    hits.increment();
+    request->status = cached.status;
+    request->contentType = cached.contentType;
+    if (!writeHeaders(*request, cached.headers) || !writeBody(*request, cached.body))
+      return CURLE_WRITE_ERROR;
+    return CURLE_OK;
+  }
+
+  // Stale, ask the origin whether it changed
+  curl_slist *conditional {};
+  if (entry.has_value() && (!entry->etag.empty() || !entry->lastModified.empty())) {
+    for (auto header = request->headers; header != nullptr; header = header->next)
+      conditional = curl_slist_append(conditional, header->data);
+    if (!entry->etag.empty())
+      conditional = curl_slist_append(conditional, ("If-None-Match: " + entry->etag).c_str());
+    if (!entry->lastModified.empty())
+      conditional = curl_slist_append(conditional, ("If-Modified-Since: " + entry->lastModified).c_str());
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, conditional);
+  }
+
+  Capture capture {};
+  capture.request = request;
+  capture.isHoldingHeaders = true;
+  capture.maxSize = maxEntrySize;
+  curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, &Capture::onHeader);
+  curl_easy_setopt(handle, CURLOPT_HEADERDATA, &capture);
+  curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, &Capture::onBody);
+  curl_easy_setopt(handle, CURLOPT_WRITEDATA, &capture);
+
+  const CURLcode code = HttpEngine::perform(handle);
+
+  curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, request->headerFunction);
+  curl_easy_setopt(handle, CURLOPT_HEADERDATA, request->headerData);
+  curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, request->writeFunction);
+  curl_easy_setopt(handle, CURLOPT_WRITEDATA, request->writeData);
+  if (conditional != nullptr) {
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, request->headers);
+    curl_slist_free_all(conditional);
+  }
+
+  if (code != CURLE_OK)
+    return code;
+
+  if (capture.status == 304 && entry.has_value()) {
+    revalidated.increment();
+    request->status = cached.status;
+    request->contentType = cached.contentType;
+    if (!writeHeaders(*request, cached.headers) || !writeBody(*request, cached.body))
+      return CURLE_WRITE_ERROR;
+
+    // A 304 may come with updated caching headers
+    const time_t ttl = ttlOf(capture.headers, request->url, now);
+    entry->storedAt = now;
+    entry->ttl = std::max(static_cast<time_t>(0), ttl);
+    writeResponse(request->url, *entry, cached);
+    return CURLE_OK;
+  }
+
+  misses.increment();
+  if (!capture.hasSentHeaders && !writeHeaders(*request, capture.headers))
+    return CURLE_WRITE_ERROR;
+
+  const time_t ttl = ttlOf(capture.headers, request->url, now);
+  Entry stored {};
+  stored.storedAt = now;
+  stored.ttl = ttl;
+  stored.etag = headerOf(capture.headers, "etag");
+  stored.lastModified = headerOf(capture.headers, "last-modified");
+
+  if (capture.status == 200 && capture.isComplete && ttl >= 0 && (ttl > 0 || !stored.etag.empty() || !stored.lastModified.empty())) {
+    Response response {};
+    response.status = capture.status;
+    response.contentType = headerOf(capture.headers, "content-type");
+    response.headers = std::move(capture.headers);
+    response.body = std::move(capture.body);
+    writeResponse(request->url, stored, response);
+  }
+  return CURLE_OK;
+}
+
+void cleanup(CURL *handle)
+{
+  store().requests.erase(handle);
+  HttpPool::cleanup(handle);
+}
+}  // namespace HttpCache
@@ -0,0 +1,32 @@
+#ifndef NONBIRI_HTTP_CACHE_H_
+#define NONBIRI_HTTP_CACHE_H_
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+#include <curl/curl.h>
+
+// Private on-disk cache for outbound GET requests. It sits behind the Http::
+// function table, so extensions use it without knowing. Responses are
+// stored according to Cache-Control, Expires, ETag and Last-Modified.
+// Stale entries are revalidated with a conditional request, and a 304 is
+// answered from the store.
+namespace HttpCache
+{
+// Stores responses under dir, evicting the least recently used ones once
+// they take up more than maxSize bytes. Until this is called every request
+// goes straight to the network.
+void initialize(const std::string &dir, uint64_t maxSize);
+// Seconds responses from host, or its subdomains, stay fresh when they
+// carry no freshness information of their own.
+void setTtl(const std::string &host, time_t ttl);
+
+// Drop-in replacements for their curl_easy_* counterparts
+CURLcode setOpt(CURL *handle, CURLoption option, ...);
+CURLcode getInfo(CURL *handle, CURLINFO info, ...);
+CURLcode perform(CURL *handle);
+void cleanup(CURL *handle);
+}  // namespace HttpCache
+
+#endif  // NONBIRI_HTTP_CACHE_H_
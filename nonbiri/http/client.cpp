@@ -0,0 +1,17 @@
+#include <core/http/http.h>
+#include <nonbiri/http/cache.h>
+#include <nonbiri/http/client.h>
+#include <nonbiri/http/fixture.h>
+#include <nonbiri/http/pool.h>
+
+void HttpClient::initialize()
+{
+  Http::init = &HttpPool::init;
+  Http::cleanup = &HttpFixture::cleanup;
+  Http::setOpt = &HttpFixture::setOpt;
+  Http::perform = &HttpFixture::perform;
+  Http::getInfo = &HttpFixture::getInfo;
+  Http::slist_append = &curl_slist_append;
+  Http::slist_freeAll = &curl_slist_free_all;
+  Http::getError = &curl_easy_strerror;
+}
@@ -0,0 +1,11 @@
+#ifndef NONBIRI_HTTP_CLIENT_H_
+#define NONBIRI_HTTP_CLIENT_H_
+
+namespace HttpClient
+{
+// Fills the Http:: function table used by the server and handed to every
+// extension on load.
+void initialize();
+}  // namespace HttpClient
+
+#endif  // NONBIRI_HTTP_CLIENT_H_
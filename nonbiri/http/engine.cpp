@@ -0,0 +1,170 @@
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <nonbiri/http/engine.h>
+#include <nonbiri/http/pool.h>
+#include <nonbiri/metrics.h>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#else
+#  include <fcntl.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+namespace HttpEngine
+{
+using Callback = std::function<void(CURLcode)>;
+
+struct Engine
+{
+  CURLM *multi {};
+  // A UDP socket connected to itself, written to by submit() to end the
+  // engine's wait early. curl_multi_poll/wakeup would do the same but need
+  // a newer libcurl than the one pinned for Hunter builds.
+  curl_socket_t wakeup {CURL_SOCKET_BAD};
+
+  std::mutex mutex {};
+  std::vector<std::pair<CURL *, Callback>> pending {};
+
+  // Only touched by the engine thread
+  std::map<CURL *, Callback> active {};
+};
+
+static thread_local bool isEngineThread {};
+
+static curl_socket_t openWakeup()
+{
+  const curl_socket_t sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock == CURL_SOCKET_BAD)
+    throw std::runtime_error("Unable to create wakeup socket");
+
+  sockaddr_in address {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t size {sizeof(address)};
+  if (bind(sock, reinterpret_cast<sockaddr *>(&address), size) != 0
+      || getsockname(sock, reinterpret_cast<sockaddr *>(&address), &size) != 0
+      || connect(sock, reinterpret_cast<sockaddr *>(&address), size) != 0)
+    throw std::runtime_error("Unable to set up wakeup socket");
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+  u_long isNonBlocking {1};
+  ioctlsocket(sock, FIONBIO, &isNonBlocking);
+#else
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+  return sock;
+}
+
+static void drainWakeup(curl_socket_t sock)
+{
+  char buffer[64];
+  while (recv(sock, buffer, sizeof(buffer), 0) > 0) {}
+}
+
+static void run(Engine &engine)
+{
+  static auto &succeeded = Metrics::counter("nonbiri_http_transfers_total", {{"result", "ok"}});
+  static auto &failed = Metrics::counter("nonbiri_http_transfers_total", {{"result", "error"}});
+  isEngineThread = true;
+
+  while (true) {
+    std::vector<std::pair<CURL *, Callback>> added {};
+    {
+      std::lock_guard lock(engine.mutex);
+      added.swap(engine.pending);
+    }
+
+    for (auto &[handle, callback] : added) {
+      const CURLMcode code = curl_multi_add_handle(engine.multi, handle);
+      if (code != CURLM_OK) {
+        failed.increment();
+        callback(CURLE_FAILED_INIT);
+        continue;
+      }
+      engine.active.emplace(handle, std::move(callback));
+    }
+
+    int running {};
+    curl_multi_perform(engine.multi, &running);
+
+    int left {};
+    while (CURLMsg *msg = curl_multi_info_read(engine.multi, &left)) {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      CURL *handle = msg->easy_handle;
+      const CURLcode result = msg->data.result;
+      curl_multi_remove_handle(engine.multi, handle);
+
+      auto it = engine.active.find(handle);
+      if (it == engine.active.end())
+        continue;
+
+      auto callback = std::move(it->second);
+      engine.active.erase(it);
+
+      HttpPool::remember(handle);
+      (result == CURLE_OK ? succeeded : failed).increment();
+      callback(result);
+    }
+
+    // Woken early by submit()
+    curl_waitfd wakeup {engine.wakeup, CURL_WAIT_POLLIN, 0};
+    curl_multi_wait(engine.multi, &wakeup, 1, 1000, nullptr);
+    if (wakeup.revents != 0)
+      drainWakeup(engine.wakeup);
+  }
+}
+
+static Engine &engine()
+{
+  static Engine *instance = [] {
+    auto e = new Engine();
+    e->multi = curl_multi_init();
+    e->wakeup = openWakeup();
+    std::thread([e] { run(*e); }).detach();
+    return e;
+  }();
+  return *instance;
+}
+
+void submit(CURL *handle, Callback callback)
+{
+  auto &e = engine();
+  {
+    std::lock_guard lock(e.mutex);
+    e.pending.emplace_back(handle, std::move(callback));
+  }
+  // A full socket buffer already has the engine woken up
+  const char byte {};
+  send(e.wakeup, &byte, 1, 0);
+}
+
+std::future<CURLcode> submit(CURL *handle)
+{
+  auto promise = std::make_shared<std::promise<CURLcode>>();
+  auto future = promise->get_future();
+  submit(handle, [promise](CURLcode code) { promise->set_value(code); });
+  return future;
+}
+
+CURLcode perform(CURL *handle)
+{
+  // Waiting on ourselves would never return
+  if (isEngineThread) {
+    const CURLcode code = curl_easy_perform(handle);
+    HttpPool::remember(handle);
+    return code;
+  }
+  return submit(handle).get();
+}
+}  // namespace HttpEngine
@@ -0,0 +1,23 @@
+#ifndef NONBIRI_HTTP_ENGINE_H_
+#define NONBIRI_HTTP_ENGINE_H_
+
+#include <functional>
+#include <future>
+
+#include <curl/curl.h>
+
+// Every outbound transfer runs on a single thread driving a curl multi
+// handle, so a request waiting on the network no longer occupies a thread
+// of its own. The caller keeps ownership of the handle and must not touch
+// it until the transfer has finished.
+namespace HttpEngine
+{
+// Blocks until the transfer has finished, used as Http::perform.
+CURLcode perform(CURL *handle);
+
+std::future<CURLcode> submit(CURL *handle);
+// The callback runs on the engine thread and should return quickly.
+void submit(CURL *handle, std::function<void(CURLcode)> callback);
+}  // namespace HttpEngine
+
+#endif  // NONBIRI_HTTP_ENGINE_H_
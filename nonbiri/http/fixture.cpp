@@ -0,0 +1,250 @@
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <json/json.h>
+#include <nonbiri/http/cache.h>
+#include <nonbiri/http/fixture.h>
+#include <nonbiri/http/shim.h>
+#include <nonbiri/log.h>
+#include <nonbiri/metrics.h>
+
+namespace fs = std::filesystem;
+
+namespace HttpFixture
+{
+using HttpShim::Capture;
+using HttpShim::Request;
+
+struct Fixture
+{
+  std::mutex mutex {};
+  Options options {};
+  std::mt19937 random {};
+
+  HttpShim::Requests requests {};
+};
+
+static Fixture &fixture()
+{
+  static Fixture instance {};
+  return instance;
+}
+
+static Metrics::Counter &requestsCounter(const std::string &result)
+{
+  return Metrics::counter("nonbiri_http_fixture_requests_total", {{"result", result}});
+}
+
+// FNV-1a, so fixture names stay the same across builds and platforms
+static std::string fileOf(const std::string &key)
+{
+  uint64_t hash {14695981039346656037ULL};
+  for (const unsigned char c : key) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  char name[17] {};
+  snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+  return name;
+}
+
+static std::string keyOf(const Request &request)
+{
+  std::string key {request.method + " " + request.url};
+  if (!request.copiedPostFields.empty()) {
+    key += "\n" + request.copiedPostFields;
+  } else if (request.postFields != nullptr) {
+    key += "\n";
+    key.append(request.postFields, request.postFieldsSize >= 0 ? request.postFieldsSize : strlen(request.postFields));
+  }
+  return key;
+}
+
+static void exportVariable(const char *name, const std::string &value)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+  _putenv_s(name, value.c_str());
+#else
+  if (value.empty())
+    unsetenv(name);
+  else
+    setenv(name, value.c_str(), 1);
+#endif
+}
+
+static void record(const std::string &dir, const std::string &key, const Request &request, long status, const Capture &capture)
+{
+  Json::Value meta {};
+  meta["method"] = request.method;
+  meta["url"] = request.url;
+  meta["key"] = key;
+  meta["status"] = static_cast<Json::Int>(status);
+  meta["contentType"] = HttpShim::headerOf(capture.headers, "content-type");
+  meta["headers"] = Json::arrayValue;
+  for (const auto &header : capture.headers)
+    meta["headers"].append(header);
+
+  if (!HttpShim::writeResponse((fs::path(dir) / fileOf(key)).string(), meta, capture.body))
+    LOG_WARN("Unable to record " << request.method << " " << request.url);
+}
+
+static CURLcode replay(const std::string &dir, const std::string &key, Request &request)
+{
+  Json::Value meta {};
+  std::string body {};
+  if (!HttpShim::readResponse((fs::path(dir) / fileOf(key)).string(), meta, body) || meta["key"].asString() != key)
+    return CURLE_COULDNT_CONNECT;
+
+  request.status = meta["status"].asInt();
+  request.contentType = meta["contentType"].asString();
+
+  std::vector<std::string> headers {};
+  for (const auto &header : meta["headers"])
+    headers.push_back(header.asString());
+  if (!HttpShim::writeHeaders(request, headers) || !HttpShim::writeBody(request, body))
+    return CURLE_WRITE_ERROR;
+  return CURLE_OK;
+}
+
+void initialize(const Options &options)
+{
+  auto &f = fixture();
+  {
+    std::lock_guard lock(f.mutex);
+    f.options = options;
+    f.random.seed(0);
+  }
+
+  if (options.mode == Mode::Off) {
+    exportVariable("NONBIRI_HTTP_FIXTURE", "");
+    return;
+  }
+
+  if (options.mode == Mode::Record) {
+    std::error_code error {};
+    fs::create_directories(options.dir, error);
+  }
+
+  exportVariable("NONBIRI_HTTP_FIXTURE", options.mode == Mode::Record ? "record" : "replay");
+  exportVariable("NONBIRI_HTTP_FIXTURE_DIR", options.dir);
+  exportVariable("NONBIRI_HTTP_FIXTURE_LATENCY", std::to_string(options.latency));
+  exportVariable("NONBIRI_HTTP_FIXTURE_JITTER", std::to_string(options.jitter));
+
+  LOG_INFO((options.mode == Mode::Record ? "Recording" : "Replaying") << " HTTP fixtures in " << options.dir);
+}
+
+void inherit()
+{
+  const char *mode = getenv("NONBIRI_HTTP_FIXTURE");
+  const char *dir = getenv("NONBIRI_HTTP_FIXTURE_DIR");
+  if (mode == nullptr || dir == nullptr)
+    return;
+
+  const char *latency = getenv("NONBIRI_HTTP_FIXTURE_LATENCY");
+  const char *jitter = getenv("NONBIRI_HTTP_FIXTURE_JITTER");
+
+  auto &f = fixture();
+  std::lock_guard lock(f.mutex);
+  f.options.mode = strcmp(mode, "record") == 0 ? Mode::Record : strcmp(mode, "replay") == 0 ? Mode::Replay : Mode::Off;
+  f.options.dir = dir;
+  f.options.latency = latency != nullptr ? atoi(latency) : 0;
+  f.options.jitter = jitter != nullptr ? atoi(jitter) : 0;
+  f.random.seed(0);
+}
+
+CURLcode setOpt(CURL *handle, CURLoption option, ...)
+{
+  va_list args {};
+  va_start(args, option);
+  const CURLcode code = fixture().requests.setOpt(HttpCache::setOpt, handle, option, args);
+  va_end(args);
+  return code;
+}
+
+CURLcode getInfo(CURL *handle, CURLINFO info, ...)
+{
+  va_list args {};
+  va_start(args, info);
+  const CURLcode code = fixture().requests.getInfo(HttpCache::getInfo, handle, info, args);
+  va_end(args);
+  return code;
+}
+
+CURLcode perform(CURL *handle)
+{
+  auto &f = fixture();
+  Options options {};
+  {
+    std::lock_guard lock(f.mutex);
+    options = f.options;
+  }
+
+  Request *request {&f.requests.of(handle)};
+  request->status = 0;
+
+  if (options.mode == Mode::Off)
+    return HttpCache::perform(handle);
+
+  const auto key = keyOf(*request);
+
+  if (options.mode == Mode::Replay) {
+    static auto &replayed = requestsCounter("replayed");
+    static auto &missing = requestsCounter("missing");
+
+    int delay = options.latency;
+    if (options.jitter > 0) {
+      std::lock_guard lock(f.mutex);
+      delay += std::uniform_int_distribution<int>(-static_cast<int>(options.jitter), options.jitter)(f.random);
+    }
+    if (delay > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+
+    const CURLcode code = replay(options.dir, key, *request);
+    if (code == CURLE_COULDNT_CONNECT) {
+      missing.increment();
+      LOG_WARN("No fixture for " << request->method << " " << request->url);
+    } else {
+      replayed.increment();
+    }
+    return code;
+  }
+
+  static auto &recorded = requestsCounter("recorded");
+
+  Capture capture {};
+  capture.request = request;
+  HttpCache::setOpt(handle, CURLOPT_HEADERFUNCTION, &Capture::onHeader);
+  HttpCache::setOpt(handle, CURLOPT_HEADERDATA, &capture);
+  HttpCache::setOpt(handle, CURLOPT_WRITEFUNCTION, &Capture::onBody);
+  HttpCache::setOpt(handle, CURLOPT_WRITEDATA, &capture);
+
+  const CURLcode code = HttpCache::perform(handle);
+
+  HttpCache::setOpt(handle, CURLOPT_HEADERFUNCTION, request->headerFunction);
+  HttpCache::setOpt(handle, CURLOPT_HEADERDATA, request->headerData);
+  HttpCache::setOpt(handle, CURLOPT_WRITEFUNCTION, request->writeFunction);
+  HttpCache::setOpt(handle, CURLOPT_WRITEDATA, request->writeData);
+
+  if (code == CURLE_OK) {
+    long status {};
+    HttpCache::getInfo(handle, CURLINFO_RESPONSE_CODE, &status);
+    record(options.dir, key, *request, status, capture);
+    recorded.increment();
+  }
+  return code;
+}
+
+void cleanup(CURL *handle)
+{
+  fixture().requests.erase(handle);
+  HttpCache::cleanup(handle);
+}
+}  // namespace HttpFixture
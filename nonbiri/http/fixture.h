@@ -0,0 +1,43 @@
+#ifndef NONBIRI_HTTP_FIXTURE_H_
+#define NONBIRI_HTTP_FIXTURE_H_
+
+#include <string>
+
+#include <curl/curl.h>
+
+// Record/replay layer in front of the Http:: function table. Recording
+// saves every outbound request and its response to a fixture directory;
+// replaying answers requests from it without touching the network, so
+// extensions can be measured offline and deterministically.
+namespace HttpFixture
+{
+enum class Mode
+{
+  Off,
+  Record,
+  Replay
+};
+
+struct Options
+{
+  Mode mode {};
+  std::string dir {};
+  // Milliseconds added to every replayed response
+  unsigned int latency {};
+  // Up to this many milliseconds more or less than latency
+  unsigned int jitter {};
+};
+
+// Also exported to the environment, for extension workers to inherit.
+void initialize(const Options &options);
+// Picks up the options of the process that started this one.
+void inherit();
+
+// Drop-in replacements for their curl_easy_* counterparts
+CURLcode setOpt(CURL *handle, CURLoption option, ...);
+CURLcode getInfo(CURL *handle, CURLINFO info, ...);
+CURLcode perform(CURL *handle);
+void cleanup(CURL *handle);
+}  // namespace HttpFixture
+
+#endif  // NONBIRI_HTTP_FIXTURE_H_
@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nonbiri/http/pool.h>
+#include <nonbiri/log.h>
+#include <nonbiri/metrics.h>
+
+namespace HttpPool
+{
+static constexpr size_t maxIdle {32};
+// Origins not used for this long are no longer prewarmed
+static constexpr time_t originTtl {10 * 60};
+
+struct Origin
+{
+  uint64_t count {};
+  time_t lastUsed {};
+};
+
+struct Pool
+{
+  CURLSH *share {};
+  std::mutex locks[CURL_LOCK_DATA_LAST] {};
+
+  std::mutex idleMutex {};
+  std::vector<CURL *> idle {};
+
+  std::mutex originsMutex {};
+  std::map<std::string, Origin> origins {};
+};
+
+static Pool &pool()
+{
+  static Pool *instance = [] {
+    auto p = new Pool();
+    p->share = curl_share_init();
+    curl_share_setopt(p->share, CURLSHOPT_LOCKFUNC, +[](CURL *, curl_lock_data data, curl_lock_access, void *ptr) {
+      static_cast<Pool *>(ptr)->locks[data].lock();
+    });
+    curl_share_setopt(p->share, CURLSHOPT_UNLOCKFUNC, +[](CURL *, curl_lock_data data, void *ptr) {
+      static_cast<Pool *>(ptr)->locks[data].unlock();
+    });
+    curl_share_setopt(p->share, CURLSHOPT_USERDATA, p);
+    curl_share_setopt(p->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(p->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(p->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    return p;
+  }();
+  return *instance;
+}
+
+// scheme://host[:port] of a URL
+static std::string originOf(const std::string &url)
+{
+  const auto scheme = url.find("://");
+  if (scheme == std::string::npos)
+    return {};
+  return url.substr(0, url.find('/', scheme + 3));
+}
+
+CURL *init()
+{
+  static auto &reused = Metrics::counter("nonbiri_http_handles_total", {{"source", "pool"}});
+  static auto &created = Metrics::counter("nonbiri_http_handles_total", {{"source", "new"}});
+  auto &p = pool();
+
+  {
+    std::lock_guard lock(p.idleMutex);
+    if (!p.idle.empty()) {
+      CURL *handle = p.idle.back();
+      p.idle.pop_back();
+      reused.increment();
+      curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+      return handle;
+    }
+  }
+
+  CURL *handle = curl_easy_init();
+  if (handle == nullptr)
+    return nullptr;
+
+  created.increment();
+  curl_easy_setopt(handle, CURLOPT_SHARE, p.share);
+  curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+  return handle;
+}
+
+void cleanup(CURL *handle)
+{
+  if (handle == nullptr)
+    return;
+
+  // Keeps the share, connections and caches, drops everything the previous
+  // user set, including callbacks that may point into an unloaded library.
+  curl_easy_reset(handle);
+
+  auto &p = pool();
+  {
+    std::lock_guard lock(p.idleMutex);
+    if (p.idle.size() < maxIdle) {
+      p.idle.push_back(handle);
+      return;
+    }
+  }
+  curl_easy_cleanup(handle);
+}
+
+void remember(CURL *handle)
+{
+  char *url {};
+  if (curl_easy_getinfo(handle, CURLINFO_EFFECTIVE_URL, &url) == CURLE_OK && url != nullptr) {
+    const auto origin = originOf(url);
+    if (!origin.empty()) {
+      auto &p = pool();
+      std::lock_guard lock(p.originsMutex);
+      auto &entry = p.origins[origin];
+      entry.count++;
+      entry.lastUsed = time(nullptr);
+    }
+  }
+}
+
+void prewarm(size_t count)
+{
+  static auto &prewarms = Metrics::counter("nonbiri_http_prewarms_total");
+  auto &p = pool();
+  const time_t now {time(nullptr)};
+
+  std::vector<std::pair<uint64_t, std::string>> candidates {};
+  {
+    std::lock_guard lock(p.originsMutex);
+    for (auto it = p.origins.begin(); it != p.origins.end();) {
+      if (now - it->second.lastUsed > originTtl) {
+        it = p.origins.erase(it);
+      } else {
+        candidates.emplace_back(it->second.count, it->first);
+        ++it;
+      }
+    }
+  }
+
+  std::sort(candidates.rbegin(), candidates.rend());
+  candidates.resize(std::min(count, candidates.size()));
+
+  // A HEAD request leaves its connection in the shared cache, unlike
+  // CURLOPT_CONNECT_ONLY which keeps it private to the handle.
+  for (const auto &[_, origin] : candidates) {
+    CURL *handle = init();
+    if (handle == nullptr)
+      break;
+
+    curl_easy_setopt(handle, CURLOPT_URL, (origin + "/").c_str());
+    curl_easy_setopt(handle, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(handle, CURLOPT_TIMEOUT, 10L);
+    const CURLcode code = curl_easy_perform(handle);
+    cleanup(handle);
+
+    if (code == CURLE_OK)
+      prewarms.increment();
+    else
+      LOG_DEBUG("Unable to prewarm " << origin << ": " << curl_easy_strerror(code));
+  }
+}
+}  // namespace HttpPool
@@ -0,0 +1,24 @@
+#ifndef NONBIRI_HTTP_POOL_H_
+#define NONBIRI_HTTP_POOL_H_
+
+#include <cstddef>
+
+#include <curl/curl.h>
+
+// Easy handles handed to Http:: and the extensions. Every handle is attached
+// to one share object, so DNS lookups, TLS sessions and open connections are
+// reused across requests instead of being set up again for each one.
+namespace HttpPool
+{
+CURL *init();
+// Resets the handle and keeps it for the next init().
+void cleanup(CURL *handle);
+// Records the origin of a finished transfer for prewarm().
+void remember(CURL *handle);
+
+// Opens connections to the most used recent origins, so the next request to
+// them skips the DNS, TCP and TLS round trips.
+void prewarm(size_t count);
+}  // namespace HttpPool
+
+#endif  // NONBIRI_HTTP_POOL_H_
@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include <nonbiri/http/shim.h>
+
+namespace fs = std::filesystem;
+
+namespace HttpShim
+{
+static std::string lower(std::string value)
+{
+  std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+  return value;
+}
+
+static std::string trim(const std::string &value)
+{
+  const auto begin = value.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos)
+    return {};
+  return value.substr(begin, value.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+static size_t write(curl_write_callback fn, void *data, const char *buffer, size_t size)
+{
+  if (fn != nullptr)
+    return fn(const_cast<char *>(buffer), 1, size, data);
+  return fwrite(buffer, 1, size, data != nullptr ? static_cast<FILE *>(data) : stdout);
+}
+
+static size_t writeHeader(const Request &request, const char *buffer, size_t size)
+{
+  // Like curl, headers are only written when someone asked for them
+  if (request.headerFunction == nullptr && request.headerData == nullptr)
+    return size;
+  const auto fn = request.headerFunction != nullptr ? request.headerFunction : request.writeFunction;
+  return write(fn, request.headerData, buffer, size);
+}
+
+Request &Requests::of(CURL *handle)
+{
+  std::lock_guard lock(mutex);
+  return requests[handle];
+}
+
+void Requests::erase(CURL *handle)
+{
+  std::lock_guard lock(mutex);
+  requests.erase(handle);
+}
+
+CURLcode Requests::setOpt(SetOpt next, CURL *handle, CURLoption option, va_list args)
+{
+  auto &request = of(handle);
+
+  CURLcode code {};
+  if (option < CURLOPTTYPE_OBJECTPOINT) {
+    const long value = va_arg(args, long);
+    code = next(handle, option, value);
+    if (option == CURLOPT_NOBODY || option == CURLOPT_POST || option == CURLOPT_UPLOAD)
+      request.isCacheable = value == 0;
+    else if (option == CURLOPT_HTTPGET && value != 0)
+      request.isCacheable = true;
+
+    if (option == CURLOPT_NOBODY && value != 0)
+      request.method = "HEAD";
+    else if (option == CURLOPT_POST && value != 0)
+      request.method = "POST";
+    else if (option == CURLOPT_UPLOAD && value != 0)
+      request.method = "PUT";
+    else if (option == CURLOPT_HTTPGET && value != 0)
+      request.method = "GET";
+    else if (option == CURLOPT_POSTFIELDSIZE)
+      request.postFieldsSize = value;
+  } else if (option < CURLOPTTYPE_FUNCTIONPOINT) {
+    void *value = va_arg(args, void *);
+    code = next(handle, option, value);
+    if (option == CURLOPT_URL) {
+      request.url = value != nullptr ? static_cast<const char *>(value) : "";
+    } else if (option == CURLOPT_WRITEDATA) {
+      request.writeData = value;
+    } else if (option == CURLOPT_HEADERDATA) {
+      request.headerData = value;
+    } else if (option == CURLOPT_HTTPHEADER) {
+      request.headers = static_cast<curl_slist *>(value);
+    } else if (option == CURLOPT_POSTFIELDS) {
+      request.postFields = static_cast<const char *>(value);
+      request.copiedPostFields.clear();
+      request.method = "POST";
+      request.isCacheable = value == nullptr;
+    } else if (option == CURLOPT_COPYPOSTFIELDS) {
+      request.postFields = nullptr;
+      request.copiedPostFields = value != nullptr ? static_cast<const char *>(value) : "";
+      request.method = "POST";
+      request.isCacheable = value == nullptr;
+    } else if (option == CURLOPT_MIMEPOST) {
+      request.isCacheable = value == nullptr;
+    } else if (option == CURLOPT_CUSTOMREQUEST) {
+      if (value != nullptr)
+        request.method = static_cast<const char *>(value);
+      request.isCacheable = value == nullptr || strcmp(static_cast<const char *>(value), "GET") == 0;
+    }
+  } else if (option < CURLOPTTYPE_OFF_T) {
+    const auto value = va_arg(args, curl_write_callback);
+    code = next(handle, option, value);
+    if (option == CURLOPT_WRITEFUNCTION)
+      request.writeFunction = value;
+    else if (option == CURLOPT_HEADERFUNCTION)
+      request.headerFunction = value;
+#if LIBCURL_VERSION_NUM >= 0x074700
+  } else if (option < CURLOPTTYPE_BLOB) {
+    code = next(handle, option, va_arg(args, curl_off_t));
+  } else {
+    // Blob options came with 7.71
+    code = next(handle, option, va_arg(args, void *));
+  }
+#else
+  } else {
+    code = next(handle, option, va_arg(args, curl_off_t));
+  }
+#endif
+  return code;
+}
+
+CURLcode Requests::getInfo(GetInfo next, CURL *handle, CURLINFO info, va_list args)
+{
+  void *value = va_arg(args, void *);
+  {
+    std::lock_guard lock(mutex);
+    auto it = requests.find(handle);
+    if (it != requests.end() && it->second.status > 0) {
+      const auto &request = it->second;
+      if (info == CURLINFO_RESPONSE_CODE) {
+        *static_cast<long *>(value) = request.status;
+        return CURLE_OK;
+      }
+      if (info == CURLINFO_CONTENT_TYPE) {
+        *static_cast<const char **>(value) = request.contentType.empty() ? nullptr : request.contentType.c_str();
+        return CURLE_OK;
+      }
+      if (info == CURLINFO_EFFECTIVE_URL) {
+        *static_cast<const char **>(value) = request.url.c_str();
+        return CURLE_OK;
+      }
+    }
+  }
+  return next(handle, info, value);
+}
+
+size_t Capture::onHeader(char *buffer, size_t size, size_t count, void *data)
+{
+  auto &capture = *static_cast<Capture *>(data);
+  const std::string line(buffer, size * count);
+
+  // Every redirect or interim response starts a new header block, only the
+  // final one is kept
+  if (line.rfind("HTTP/", 0) == 0) {
+    capture.headers.clear();
+    const auto space = line.find(' ');
+    capture.status = space == std::string::npos ? 0 : atol(line.c_str() + space + 1);
+  }
+  capture.headers.push_back(line);
+  if (capture.isHoldingHeaders)
+    return size * count;
+  return writeHeader(*capture.request, buffer, size * count);
+}
+
+size_t Capture::onBody(char *buffer, size_t size, size_t count, void *data)
+{
+  auto &capture = *static_cast<Capture *>(data);
+  if (capture.isHoldingHeaders && !capture.hasSentHeaders) {
+    capture.hasSentHeaders = true;
+    if (!writeHeaders(*capture.request, capture.headers))
+      return 0;
+  }
+
+  if (capture.isComplete && capture.body.size() + size * count <= capture.maxSize) {
+    capture.body.append(buffer, size * count);
+  } else {
+    capture.isComplete = false;
+    capture.body.clear();
+  }
+  return write(capture.request->writeFunction, capture.request->writeData, buffer, size * count);
+}
+
+std::string headerOf(const std::vector<std::string> &headers, const std::string &name)
+{
+  std::string value {};
+  for (const auto &line : headers) {
+    const auto colon = line.find(':');
+    if (colon != std::string::npos && lower(trim(line.substr(0, colon))) == name)
+      value = trim(line.substr(colon + 1));
+  }
+  return value;
+}
+
+bool writeHeaders(const Request &request, const std::vector<std::string> &headers)
+{
+  for (const auto &header : headers) {
+    if (writeHeader(request, header.data(), header.size()) != header.size())
+      return false;
+  }
+  return true;
+}
+
+bool writeBody(const Request &request, const std::string &body)
+{
+  for (size_t offset = 0; offset < body.size(); offset += CURL_MAX_WRITE_SIZE) {
+    const size_t size = std::min<size_t>(CURL_MAX_WRITE_SIZE, body.size() - offset);
+    if (write(request.writeFunction, request.writeData, body.data() + offset, size) != size)
+      return false;
+  }
+  return true;
+}
+
+bool readResponse(const std::string &path, Json::Value &meta, std::string &body)
+{
+  std::ifstream file(path, std::ios::binary);
+  std::string line {};
+  Json::Reader reader {};
+  if (!file.is_open() || !std::getline(file, line) || !reader.parse(line, meta) || !meta.isObject())
+    return false;
+
+  std::stringstream content {};
+  content << file.rdbuf();
+  body = content.str();
+  return true;
+}
+
+bool writeResponse(const std::string &path, const Json::Value &meta, const std::string &body)
+{
+  static std::atomic<uint64_t> counter {};
+  const auto tmp = path + "." + std::to_string(counter++) + ".tmp";
+  std::error_code error {};
+  {
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    Json::FastWriter writer {};
+    file << writer.write(meta);
+    file.write(body.data(), body.size());
+    if (!file.good()) {
+      file.close();
+      fs::remove(tmp, error);
+      return false;
+    }
+  }
+
+  fs::rename(tmp, path, error);
+  if (error) {
+    fs::remove(tmp, error);
+    return false;
+  }
+  return true;
+}
+}  // namespace HttpShim
@@ -0,0 +1,93 @@
+#ifndef NONBIRI_HTTP_SHIM_H_
+#define NONBIRI_HTTP_SHIM_H_
+
+#include <cstdarg>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <curl/curl.h>
+#include <json/json.h>
+
+// Shared by the layers that sit behind the Http:: function table and answer
+// or record transfers themselves, the cache and the fixtures. They track
+// what the caller set on a handle, hand stored responses to its callbacks
+// and keep responses on disk in the same format.
+namespace HttpShim
+{
+using SetOpt = CURLcode (*)(CURL *handle, CURLoption option, ...);
+using GetInfo = CURLcode (*)(CURL *handle, CURLINFO info, ...);
+
+// What the caller set on a handle
+struct Request
+{
+  std::string url {};
+  std::string method {"GET"};
+  bool isCacheable {true};
+  const char *postFields {};
+  long postFieldsSize {-1};
+  std::string copiedPostFields {};
+  curl_write_callback writeFunction {};
+  void *writeData {};
+  curl_write_callback headerFunction {};
+  void *headerData {};
+  curl_slist *headers {};
+
+  // Set when the last response did not come from the network
+  long status {};
+  std::string contentType {};
+};
+
+// The requests of the handles a layer has seen
+class Requests
+{
+  std::mutex mutex {};
+  std::map<CURL *, Request> requests {};
+
+public:
+  // Stays valid until erase(), only the thread using the handle touches it
+  Request &of(CURL *handle);
+  void erase(CURL *handle);
+
+  // Records option on the request of handle and passes it on to next
+  CURLcode setOpt(SetOpt next, CURL *handle, CURLoption option, va_list args);
+  // Answers for responses that did not come from the network, asks next
+  // about everything else
+  CURLcode getInfo(GetInfo next, CURL *handle, CURLINFO info, va_list args);
+};
+
+// Tees a response into memory while handing it to the caller. Headers can
+// be held back until the body starts, so a 304 never reaches the caller.
+struct Capture
+{
+  Request *request {};
+  bool isHoldingHeaders {};
+  // Bodies past this size are passed on without being kept
+  size_t maxSize {static_cast<size_t>(-1)};
+
+  long status {};
+  std::vector<std::string> headers {};
+  bool hasSentHeaders {};
+  std::string body {};
+  bool isComplete {true};
+
+  static size_t onHeader(char *buffer, size_t size, size_t count, void *data);
+  static size_t onBody(char *buffer, size_t size, size_t count, void *data);
+};
+
+// Value of the last header called name, empty if there is none
+std::string headerOf(const std::vector<std::string> &headers, const std::string &name);
+
+bool writeHeaders(const Request &request, const std::vector<std::string> &headers);
+bool writeBody(const Request &request, const std::string &body);
+
+// The first line holds the metadata as JSON, the body follows as is.
+bool readResponse(const std::string &path, Json::Value &meta, std::string &body);
+// Written to a temp file of its own and renamed over path, so concurrent
+// writers of the same path never mix their content
+bool writeResponse(const std::string &path, const Json::Value &meta, const std::string &body);
+}  // namespace HttpShim
+
+#endif  // NONBIRI_HTTP_SHIM_H_
@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+#  define WIN32_LEAN_AND_MEAN
+#  include <Windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include <core/http/http.h>
+#include <json/json.h>
+#include <nonbiri/images.h>
+#include <nonbiri/log.h>
+#include <nonbiri/metrics.h>
+
+namespace fs = std::filesystem;
+
+namespace Images
+{
+// Anything larger is not a page
+static constexpr uint64_t maxImageSize {64 * 1024 * 1024};
+
+struct Entry
+{
+  std::string file {};
+  std::string contentType {};
+  uint64_t size {};
+  time_t lastUsed {};
+};
+
+struct Store
+{
+  std::mutex mutex {};
+  bool isInitialized {};
+  std::string dir {};
+  uint64_t maxSize {};
+  uint64_t size {};
+  std::map<std::string, Entry> entries {};
+  // Downloads in progress, later callers wait on them instead of starting their own
+  std::map<std::string, std::shared_future<Image>> pending {};
+  // Image hosts by domain, see allow()
+  std::map<std::string, std::set<std::string>> hosts {};
+};
+
+struct Download
+{
+  std::ofstream file {};
+  uint64_t size {};
+};
+
+static Store &store()
+{
+  static Store instance {};
+  return instance;
+}
+
+static Metrics::Counter &requestsCounter(const std::string &result)
+{
+  return Metrics::counter("nonbiri_image_cache_requests_total", {{"result", result}});
+}
+
+static std::string fileOf(const std::string &url)
+{
+  char name[17] {};
+  snprintf(name, sizeof(name), "%016zx", std::hash<std::string> {}(url));
+  return name;
+}
+
+// Must be called under the store mutex, so the file is open before an
+// eviction gets to remove it
+static Image imageOf(const Store &s, const Entry &entry)
+{
+  const auto path = (fs::path(s.dir) / entry.file).string();
+  return {path, entry.contentType, entry.size, std::make_shared<Mapping>(path)};
+}
+
+// The lowercase host of an http or https URL, empty for anything else
+static std::string hostOf(const std::string &url)
+{
+  const auto scheme = url.find("://");
+  if (scheme == std::string::npos)
+    return "";
+  std::string protocol = url.substr(0, scheme);
+  std::transform(protocol.begin(), protocol.end(), protocol.begin(), [](unsigned char c) { return std::tolower(c); });
+  if (protocol != "http" && protocol != "https")
+    return "";
+
+  const auto start = scheme + 3;
+  const auto end = url.find_first_of("/?#", start);
+  std::string host = url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+  // Credentials in the URL only serve to disguise the host
+  if (host.find_first_of("@\\") != std::string::npos)
+    return "";
+  const auto port = host.rfind(':');
+  if (port != std::string::npos && host.find(']', port) == std::string::npos)
+    host.erase(port);
+  std::transform(host.begin(), host.end(), host.begin(), [](unsigned char c) { return std::tolower(c); });
+  return host;
+}
+
+static size_t onWrite(char *buffer, size_t size, size_t count, void *data)
+{
+  auto &download = *static_cast<Download *>(data);
+  download.size += size * count;
+  if (download.size > maxImageSize)
+    return 0;
+  download.file.write(buffer, size * count);
+  return download.file.good() ? size * count : 0;
+}
+
+// Adds a stored image, evicting the least recently used ones but never the
+// image just added, and returns it.
+static Image insert(const std::string &url, const Entry &entry)
+{
+  auto &s = store();
+  Json::Value meta {};
+  meta["url"] = url;
+  meta["contentType"] = entry.contentType;
+  meta["storedAt"] = static_cast<Json::Int64>(entry.lastUsed);
+  Json::FastWriter writer {};
+  std::ofstream((fs::path(s.dir) / (entry.file + ".json")).string(), std::ios::trunc) << writer.write(meta);
+
+  static auto &evictions = Metrics::counter("nonbiri_image_cache_evictions_total");
+  std::vector<std::string> evicted {};
+  Image image {};
+  {
+    std::lock_guard lock(s.mutex);
+    const auto it = s.entries.find(url);
+    if (it != s.entries.end())
+      s.size -= it->second.size;
+    s.entries[url] = entry;
+    s.size += entry.size;
+
+    while (s.size > s.maxSize && s.entries.size() > 1) {
+      auto oldest = s.entries.end();
+      for (auto candidate = s.entries.begin(); candidate != s.entries.end(); candidate++) {
+        if (candidate->first != url && (oldest == s.entries.end() || candidate->second.lastUsed < oldest->second.lastUsed))
+          oldest = candidate;
+      }
+      s.size -= oldest->second.size;
+      evicted.push_back(oldest->second.file);
+      s.entries.erase(oldest);
+      evictions.increment();
+    }
+    image = imageOf(s, entry);
+  }
+
+  // Images still being served stay readable until they are unmapped
+  std::error_code error {};
+  for (const auto &file : evicted) {
+    fs::remove(fs::path(s.dir) / file, error);
+    fs::remove(fs::path(s.dir) / (file + ".json"), error);
+  }
+  return image;
+}
+
+static Image download(const std::string &url, const std::string &referer)
+{
+  auto &s = store();
+  Entry entry {};
+  entry.file = fileOf(url);
+  const auto path = fs::path(s.dir) / entry.file;
+  entry.contentType = save(url, path.string(), referer);
+  entry.size = fs::file_size(path);
+  entry.lastUsed = time(nullptr);
+  return insert(url, entry);
+}
+
+std::string save(const std::string &url, const std::string &path, const std::string &referer)
+{
+  const auto tmp = path + ".tmp";
+  CURL *curl = Http::init();
+  if (curl == nullptr)
+    throw std::runtime_error("Unable to initialize curl");
+
+  curl_slist *headers {};
+  // Images are kept here, the outbound cache needs no copy of its own
+  headers = Http::slist_append(headers, "Cache-Control: no-store");
+  if (!referer.empty())
+    headers = Http::slist_append(headers, ("Referer: " + referer).c_str());
+
+  Download data {};
+  data.file.open(tmp, std::ios::binary | std::ios::trunc);
+  Http::setOpt(curl, CURLOPT_URL, url.c_str());
+  // Neither the URL nor a redirect gets to reach file:// and the like
+  Http::setOpt(curl, CURLOPT_PROTOCOLS, static_cast<long>(CURLPROTO_HTTP | CURLPROTO_HTTPS));
+  Http::setOpt(curl, CURLOPT_REDIR_PROTOCOLS, static_cast<long>(CURLPROTO_HTTP | CURLPROTO_HTTPS));
+  Http::setOpt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  Http::setOpt(curl, CURLOPT_HTTPHEADER, headers);
+  Http::setOpt(curl, CURLOPT_WRITEFUNCTION, onWrite);
+  Http::setOpt(curl, CURLOPT_WRITEDATA, &data);
+
+  const CURLcode code = Http::perform(curl);
+  long status {};
+  char *type {};
+  Http::getInfo(curl, CURLINFO_RESPONSE_CODE, &status);
+  Http::getInfo(curl, CURLINFO_CONTENT_TYPE, &type);
+  const std::string contentType {type != nullptr ? type : "application/octet-stream"};
+  Http::cleanup(curl);
+  Http::slist_freeAll(headers);
+  data.file.close();
+
+  std::error_code error {};
+  if (code != CURLE_OK || status < 200 || status >= 300 || data.size == 0) {
+    fs::remove(tmp, error);
+    if (code != CURLE_OK)
+      throw std::runtime_error(std::string("Unable to fetch image: ") + Http::getError(code));
+    throw std::runtime_error("Unable to fetch image: status " + std::to_string(status));
+  }
+
+  fs::rename(tmp, path, error);
+  if (error) {
+    fs::remove(tmp, error);
+    throw std::runtime_error("Unable to store image: " + error.message());
+  }
+  return contentType;
+}
+
+void initialize(const std::string &dir, uint64_t maxSize)
+{
+  auto &s = store();
+  std::lock_guard lock(s.mutex);
+  s.dir = dir;
+  s.maxSize = maxSize;
+  s.isInitialized = true;
+
+  std::error_code error {};
+  fs::create_directories(dir, error);
+  std::vector<fs::path> images {};
+  for (const auto &file : fs::directory_iterator(dir, error)) {
+    const auto path = file.path();
+    if (path.extension() == ".tmp") {
+      fs::remove(path, error);
+      continue;
+    }
+    if (path.extension() != ".json") {
+      images.push_back(path);
+      continue;
+    }
+
+    std::ifstream stream(path);
+    Json::Value meta {};
+    Json::Reader reader {};
+    const auto image = fs::path(path).replace_extension();
+    if (!reader.parse(stream, meta) || !fs::exists(image, error)) {
+      fs::remove(path, error);
+      continue;
+    }
+
+    Entry entry {};
+    entry.file = image.filename().string();
+    entry.contentType = meta["contentType"].asString();
+    entry.size = fs::file_size(image, error);
+    entry.lastUsed = meta["storedAt"].asInt64();
+    s.entries[meta["url"].asString()] = entry;
+    s.size += entry.size;
+  }
+
+  // Left behind by an eviction that could not remove them at the time
+  for (const auto &path : images) {
+    if (!fs::exists(path.string() + ".json", error))
+      fs::remove(path, error);
+  }
+
+  LOG_INFO("Image cache holds " << s.entries.size() << " images (" << s.size / 1024 << " KiB)");
+}
+
+Image fetch(const std::string &url, const std::string &referer)
+{
+  auto &s = store();
+  std::promise<Image> promise {};
+  std::shared_future<Image> result {};
+  bool isOwner {};
+  {
+    std::lock_guard lock(s.mutex);
+    if (!s.isInitialized)
+      throw std::runtime_error("Images::initialize() was not called");
+
+    const auto it = s.entries.find(url);
+    if (it != s.entries.end()) {
+      requestsCounter("hit").increment();
+      it->second.lastUsed = time(nullptr);
+      return imageOf(s, it->second);
+    }
+
+    const auto pending = s.pending.find(url);
+    if (pending != s.pending.end()) {
+      requestsCounter("shared").increment();
+      result = pending->second;
+    } else {
+      requestsCounter("miss").increment();
+      result = promise.get_future().share();
+      s.pending.emplace(url, result);
+      isOwner = true;
+    }
+  }
+
+  if (!isOwner)
+    return result.get();
+
+  try {
+    promise.set_value(download(url, referer));
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+  }
+
+  {
+    std::lock_guard lock(s.mutex);
+    s.pending.erase(url);
+  }
+  return result.get();
+}
+
+bool has(const std::string &url)
+{
+  auto &s = store();
+  std::lock_guard lock(s.mutex);
+  return s.entries.find(url) != s.entries.end();
+}
+
+std::optional<Image> find(const std::string &key)
+{
+  auto &s = store();
+  std::lock_guard lock(s.mutex);
+  const auto it = s.entries.find(key);
+  if (it == s.entries.end())
+    return std::nullopt;
+  it->second.lastUsed = time(nullptr);
+  return imageOf(s, it->second);
+}
+
+Image put(const std::string &key, const std::string &contentType, const std::string &data)
+{
+  auto &s = store();
+  Entry entry {};
+  entry.file = fileOf(key);
+  entry.contentType = contentType;
+  entry.size = data.size();
+  entry.lastUsed = time(nullptr);
+
+  const auto path = fs::path(s.dir) / entry.file;
+  const auto tmp = path.string() + ".tmp";
+  {
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+    if (!file.good())
+      throw std::runtime_error("Unable to store image " + key);
+  }
+
+  std::error_code error {};
+  fs::rename(tmp, path, error);
+  if (error) {
+    fs::remove(tmp, error);
+    throw std::runtime_error("Unable to store image: " + error.message());
+  }
+
+  return insert(key, entry);
+}
+
+void allow(const std::string &domain, const std::string &url)
+{
+  const auto host = hostOf(url);
+  if (host.empty())
+    return;
+  auto &s = store();
+  std::lock_guard lock(s.mutex);
+  s.hosts[domain].insert(host);
+}
+
+bool isAllowed(const std::string &domain, const std::string &baseUrl, const std::string &url)
+{
+  const auto host = hostOf(url);
+  if (host.empty())
+    return false;
+  if (host == hostOf(baseUrl))
+    return true;
+  auto &s = store();
+  std::lock_guard lock(s.mutex);
+  const auto it = s.hosts.find(domain);
+  return it != s.hosts.end() && it->second.find(host) != it->second.end();
+}
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+Mapping::Mapping(const std::string &path)
+{
+  mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr);
+  if (mFile == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("Unable to open " + path);
+
+  LARGE_INTEGER size {};
+  GetFileSizeEx(mFile, &size);
+  mSize = static_cast<size_t>(size.QuadPart);
+  if (mSize == 0)
+    return;
+
+  mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mMapping != nullptr)
+    mData = static_cast<const char *>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+  if (mData == nullptr) {
+    if (mMapping != nullptr)
+      CloseHandle(mMapping);
+    CloseHandle(mFile);
+    throw std::runtime_error("Unable to map " + path);
+  }
+}
+
+Mapping::~Mapping()
+{
+  if (mData != nullptr)
+    UnmapViewOfFile(mData);
+  if (mMapping != nullptr)
+    CloseHandle(mMapping);
+  CloseHandle(mFile);
+}
+#else
+Mapping::Mapping(const std::string &path)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Unable to open " + path);
+
+  struct stat info {};
+  fstat(fd, &info);
+  mSize = static_cast<size_t>(info.st_size);
+  if (mSize > 0) {
+    void *data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    mData = data != MAP_FAILED ? static_cast<const char *>(data) : nullptr;
+  }
+  // The mapping keeps the file alive on its own
+  close(fd);
+  if (mSize > 0 && mData == nullptr)
+    throw std::runtime_error("Unable to map " + path);
+}
+
+Mapping::~Mapping()
+{
+  if (mData != nullptr)
+    munmap(const_cast<char *>(mData), mSize);
+}
+#endif
+
+const char *Mapping::data() const
+{
+  return mData;
+}
+
+size_t Mapping::size() const
+{
+  return mSize;
+}
+}  // namespace Images
@@ -0,0 +1,68 @@
+#ifndef NONBIRI_IMAGES_H_
+#define NONBIRI_IMAGES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+// On-disk store of page and cover images served through /api/image, so a
+// re-read or a second device does not go back to the source. The least
+// recently used images are evicted once the store grows past its size.
+namespace Images
+{
+// A stored image mapped into memory, unmapped when the last reference goes
+class Mapping
+{
+  const char *mData {};
+  size_t mSize {};
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+  void *mFile {};
+  void *mMapping {};
+#endif
+
+public:
+  Mapping(const std::string &path);
+  ~Mapping();
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+
+  const char *data() const;
+  size_t size() const;
+};
+
+struct Image
+{
+  std::string path {};
+  std::string contentType {};
+  uint64_t size {};
+  // Opened before the store lets go of the file, an eviction can no longer
+  // take it away from the caller
+  std::shared_ptr<Mapping> mapping {};
+};
+
+// Loads the index of dir, must be called before anything else.
+void initialize(const std::string &dir, uint64_t maxSize);
+
+// Returns the stored copy of url, downloading it first if needed. Callers
+// asking for the same url at once share a single download. Throws when the
+// source does not answer with an image.
+Image fetch(const std::string &url, const std::string &referer = "");
+bool has(const std::string &url);
+// The image stored under key, without downloading anything
+std::optional<Image> find(const std::string &key);
+// Downloads url to path without keeping a copy in the store, returns its
+// content type
+std::string save(const std::string &url, const std::string &path, const std::string &referer = "");
+// Stores an image made here rather than downloaded, such as a thumbnail
+Image put(const std::string &key, const std::string &contentType, const std::string &data);
+
+// Lets the proxy fetch images of domain from the host of url. Only the host
+// of the source itself and the hosts of the URLs handed out for it are
+// allowed, anything else would turn the proxy into an open one.
+void allow(const std::string &domain, const std::string &url);
+bool isAllowed(const std::string &domain, const std::string &baseUrl, const std::string &url);
+}  // namespace Images
+
+#endif  // NONBIRI_IMAGES_H_
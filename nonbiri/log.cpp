@@ -0,0 +1,236 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <nonbiri/log.h>
+
+namespace fs = std::filesystem;
+
+namespace Log
+{
+static constexpr auto writeInterval {std::chrono::milliseconds(50)};
+static constexpr const char *levelNames[] {"DEBUG", "INFO ", "WARN ", "ERROR"};
+
+// Lines are appended by the owning thread and swapped out by the writer, so
+// the mutex is only ever contended for the duration of a swap.
+struct Buffer
+{
+  std::mutex mutex {};
+  std::string out {};
+  std::string err {};
+  std::atomic<bool> orphaned {};
+};
+
+struct Writer
+{
+  std::mutex buffersMutex {};
+  std::vector<std::shared_ptr<Buffer>> buffers {};
+
+  std::mutex outputMutex {};
+  std::string path {};
+  uint64_t maxSize {};
+  unsigned int maxFiles {};
+  uint64_t size {};
+  std::ofstream file {};
+};
+
+static Writer &writer()
+{
+  static Writer instance {};
+  return instance;
+}
+
+// Runs on the writer thread, so nothing here may throw. When the file can't
+// be moved aside, e.g. because another process has it open on Windows,
+// logging goes on in the current file and rotation is retried once it has
+// grown by maxSize again.
+static void rotate(Writer &w)
+{
+  std::error_code error {};
+  w.file.close();
+  for (unsigned int i = w.maxFiles; i > 1; i--) {
+    const std::string from {w.path + "." + std::to_string(i - 1)};
+    if (fs::exists(from, error))
+      fs::rename(from, w.path + "." + std::to_string(i), error);
+  }
+  error.clear();
+  if (w.maxFiles > 0)
+    fs::rename(w.path, w.path + ".1", error);
+
+  w.file.open(w.path, std::ios::out | (w.maxFiles > 0 && error ? std::ios::app : std::ios::trunc));
+  w.size = 0;
+}
+
+static void write(Writer &w, const std::string &out, const std::string &err)
+{
+  if (!w.file.is_open()) {
+    if (!out.empty())
+      fwrite(out.data(), 1, out.size(), stdout);
+    if (!err.empty())
+      fwrite(err.data(), 1, err.size(), stderr);
+    fflush(stdout);
+    fflush(stderr);
+    return;
+  }
+
+  w.file << out << err;
+  w.file.flush();
+  w.size += out.size() + err.size();
+  if (w.maxSize > 0 && w.size >= w.maxSize)
+    rotate(w);
+}
+
+static void drain()
+{
+  auto &w = writer();
+  std::string out {};
+  std::string err {};
+
+  std::lock_guard outputLock(w.outputMutex);
+  {
+    std::lock_guard lock(w.buffersMutex);
+    for (auto it = w.buffers.begin(); it != w.buffers.end();) {
+      auto &buffer = **it;
+      // Read before swapping, a thread may still log right before exiting.
+      const bool orphaned = buffer.orphaned.load(std::memory_order_acquire);
+      {
+        std::lock_guard bufferLock(buffer.mutex);
+        out += buffer.out;
+        err += buffer.err;
+        buffer.out.clear();
+        buffer.err.clear();
+      }
+
+      if (orphaned)
+        it = w.buffers.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  if (!out.empty() || !err.empty())
+    write(w, out, err);
+}
+
+struct Registration
+{
+  std::shared_ptr<Buffer> buffer {std::make_shared<Buffer>()};
+
+  Registration()
+  {
+    static std::once_flag once {};
+    std::call_once(once, [] {
+      std::thread([] {
+        while (true) {
+          std::this_thread::sleep_for(writeInterval);
+          drain();
+        }
+      }).detach();
+    });
+
+    auto &w = writer();
+    std::lock_guard lock(w.buffersMutex);
+    w.buffers.push_back(buffer);
+  }
+
+  ~Registration()
+  {
+    buffer->orphaned.store(true, std::memory_order_release);
+  }
+};
+
+static std::string timestamp()
+{
+  const auto now = std::chrono::system_clock::now();
+  const time_t seconds = std::chrono::system_clock::to_time_t(now);
+  const auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+
+  tm local {};
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+  localtime_s(&local, &seconds);
+#else
+  localtime_r(&seconds, &local);
+#endif
+
+  char buffer[32] {};
+  const size_t n = strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+  snprintf(buffer + n, sizeof(buffer) - n, ".%03d", static_cast<int>(millis));
+  return buffer;
+}
+
+void setFile(const std::string &path, uint64_t maxSize, unsigned int maxFiles)
+{
+  drain();
+
+  auto &w = writer();
+  std::lock_guard lock(w.outputMutex);
+  if (w.file.is_open())
+    w.file.close();
+
+  w.path = path;
+  w.maxSize = maxSize;
+  w.maxFiles = maxFiles;
+  w.file.open(path, std::ios::out | std::ios::app);
+
+  std::error_code error {};
+  const auto size = fs::file_size(path, error);
+  w.size = w.file.is_open() && !error ? size : 0;
+}
+
+void flush()
+{
+  drain();
+}
+
+// A message whose formatting logs something itself gets a stream per level
+// of nesting, so the inner line doesn't clobber the outer one.
+struct Streams
+{
+  std::vector<std::unique_ptr<std::ostringstream>> pool {};
+  size_t depth {};
+};
+
+static Streams &threadStreams()
+{
+  thread_local Streams streams {};
+  return streams;
+}
+
+static std::ostringstream &acquireStream()
+{
+  auto &streams = threadStreams();
+  if (streams.depth == streams.pool.size())
+    streams.pool.push_back(std::make_unique<std::ostringstream>());
+  return *streams.pool[streams.depth++];
+}
+
+Line::Line(Level level) : mLevel {level}, stream {acquireStream()}
+{
+  stream.str({});
+  stream.clear();
+}
+
+Line::~Line()
+{
+  thread_local Registration registration {};
+  auto &buffer = *registration.buffer;
+
+  std::string line {timestamp()};
+  line += ' ';
+  line += levelNames[static_cast<int>(mLevel)];
+  line += ' ';
+  line += stream.str();
+  line += '\n';
+  threadStreams().depth--;
+
+  std::lock_guard lock(buffer.mutex);
+  (mLevel >= Level::Warn ? buffer.err : buffer.out) += line;
+}
+}  // namespace Log
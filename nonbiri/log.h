@@ -0,0 +1,62 @@
+#ifndef NONBIRI_LOG_H_
+#define NONBIRI_LOG_H_
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// Messages below this level are compiled out, 0 keeps debug messages.
+#ifndef NONBIRI_LOG_LEVEL
+#  define NONBIRI_LOG_LEVEL 1
+#endif
+
+namespace Log
+{
+enum class Level
+{
+  Debug,
+  Info,
+  Warn,
+  Error
+};
+
+// Writes to the given file instead of stdout/stderr, rotating it to
+// path.1 .. path.N once it grows past maxSize bytes (0 disables rotation).
+void setFile(const std::string &path, uint64_t maxSize = 0, unsigned int maxFiles = 3);
+
+// Blocks until everything logged so far has been written.
+void flush();
+
+// Formats a single message into a reused thread-local stream, the finished
+// line is handed to the writer thread without touching stdio.
+class Line
+{
+  const Level mLevel;
+
+public:
+  std::ostringstream &stream;
+
+  Line(Level level);
+  ~Line();
+};
+}  // namespace Log
+
+#define NONBIRI_LOG(level, message) \
+  do { \
+    Log::Line line_(level); \
+    line_.stream << message; \
+  } while (0)
+
+#if NONBIRI_LOG_LEVEL <= 0
+#  define LOG_DEBUG(message) NONBIRI_LOG(Log::Level::Debug, message)
+#else
+#  define LOG_DEBUG(message) \
+    do { \
+    } while (0)
+#endif
+
+#define LOG_INFO(message)  NONBIRI_LOG(Log::Level::Info, message)
+#define LOG_WARN(message)  NONBIRI_LOG(Log::Level::Warn, message)
+#define LOG_ERROR(message) NONBIRI_LOG(Log::Level::Error, message)
+
+#endif  // NONBIRI_LOG_H_
@@ -8,9 +8,16 @@
 template class LRU<std::shared_ptr<Manga>>;
 template class LRU<std::shared_ptr<Chapter>>;
 template class LRU<std::vector<std::shared_ptr<Chapter>>>;
+template class LRU<std::vector<std::string>>;
+template class LRU<std::string>;
 
 template<class T>
-LRU<T>::LRU(unsigned int maxSize) : mMaxSize {maxSize}
+LRU<T>::LRU(const std::string &name, unsigned int maxSize, unsigned int ttl) :
+  mMaxSize {maxSize},
+  mTtl {ttl},
+  hits {Metrics::counter("nonbiri_cache_hits_total", {{"cache", name}})},
+  misses {Metrics::counter("nonbiri_cache_misses_total", {{"cache", name}})},
+  evictions {Metrics::counter("nonbiri_cache_evictions_total", {{"cache", name}})}
 {
 }
 
@@ -19,49 +26,51 @@ LRU<T>::~LRU()
 {
 }
 
-template<>
-std::vector<std::shared_ptr<Chapter>> LRU<std::vector<std::shared_ptr<Chapter>>>::get(const std::string &key)
-{
-  std::shared_lock lock(mutex);
-  const auto it = cache.find(key);
-  if (it == cache.end())
-    return {};
-
-  keys.remove(key);
-  keys.push_front(key);
-
-  return it->second;
-}
-
+// A hit reorders keys, so lookups need the exclusive lock as well.
 template<class T>
 T LRU<T>::get(const std::string &key)
 {
-  std::shared_lock lock(mutex);
+  std::lock_guard lock(mutex);
   const auto it = cache.find(key);
-  if (it == cache.end())
-    return nullptr;
+  if (it == cache.end()) {
+    misses.increment();
+    return {};
+  }
 
-  keys.remove(key);
-  keys.push_front(key);
+  if (mTtl > 0 && it->second.expiresAt <= time(nullptr)) {
+    keys.erase(it->second.key);
+    cache.erase(it);
+    misses.increment();
+    return {};
+  }
+
+  hits.increment();
+  keys.splice(keys.begin(), keys, it->second.key);
 
-  return it->second;
+  return it->second.value;
 }
 
 template<class T>
 void LRU<T>::set(const std::string &key, T value)
 {
   std::lock_guard lock(mutex);
+  const time_t expiresAt = mTtl > 0 ? time(nullptr) + mTtl : 0;
   const auto it = cache.find(key);
-  if (it != cache.end())
-    keys.remove(key);
+  if (it != cache.end()) {
+    keys.splice(keys.begin(), keys, it->second.key);
+    it->second.value = std::move(value);
+    it->second.expiresAt = expiresAt;
+    return;
+  }
 
-  cache[key] = value;
   keys.push_front(key);
+  cache.emplace(key, Entry {std::move(value), keys.begin(), expiresAt});
 
   while (cache.size() > mMaxSize) {
     const auto last = keys.back();
     keys.pop_back();
     cache.erase(last);
+    evictions.increment();
   }
 }
 
@@ -69,7 +78,8 @@ template<class T>
 bool LRU<T>::has(const std::string &key)
 {
   std::shared_lock lock(mutex);
-  return cache.find(key) != cache.end();
+  const auto it = cache.find(key);
+  return it != cache.end() && (mTtl == 0 || it->second.expiresAt > time(nullptr));
 }
 
 template<class T>
@@ -78,7 +88,7 @@ void LRU<T>::remove(const std::string &key)
   std::lock_guard lock(mutex);
   const auto it = cache.find(key);
   if (it != cache.end()) {
-    keys.remove(key);
+    keys.erase(it->second.key);
     cache.erase(it);
   }
 }
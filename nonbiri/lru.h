@@ -1,22 +1,40 @@
 #ifndef NONBIRI_LRU_H_
 #define NONBIRI_LRU_H_
 
+#include <ctime>
 #include <list>
 #include <map>
 #include <shared_mutex>
 #include <string>
 
+#include <nonbiri/metrics.h>
+
 template<class T>
 class LRU
 {
   const unsigned int mMaxSize;
+  // Seconds an entry stays valid, 0 keeps it until evicted
+  const unsigned int mTtl;
   std::shared_mutex mutex;
 
-  std::map<std::string, T> cache;
+  Metrics::Counter &hits;
+  Metrics::Counter &misses;
+  Metrics::Counter &evictions;
+
+  struct Entry
+  {
+    T value;
+    // Its place in keys
+    std::list<std::string>::iterator key;
+    time_t expiresAt;
+  };
+
+  // Most recently used first
   std::list<std::string> keys;
+  std::map<std::string, Entry> cache;
 
 public:
-  LRU(unsigned int maxSize);
+  LRU(const std::string &name, unsigned int maxSize, unsigned int ttl = 0);
   ~LRU();
 
   T get(const std::string &key);
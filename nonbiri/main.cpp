@@ -1,14 +1,24 @@
-#include <iostream>
+#include <cstring>
 #include <stdexcept>
 
 #include <nonbiri/app.h>
+#include <nonbiri/log.h>
+#include <nonbiri/sandbox.h>
 
 int main(int argc, char *argv[])
 {
+  // Started by Sandbox::IsolatedExtension to host a single extension.
+  if (argc > 1 && strcmp(argv[1], "--worker") == 0) {
+    const int code = Sandbox::serve();
+    Log::flush();
+    return code;
+  }
+
   try {
     App::initialize(argc, argv);
     App::start();
   } catch (const std::exception &e) {
-    std::cerr << e.what() << std::endl;
+    LOG_ERROR(e.what());
   }
+  Log::flush();
 }
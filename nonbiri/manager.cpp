@@ -1,17 +1,30 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
+#include <ctime>
 #include <filesystem>
-#include <iostream>
+#include <fstream>
+#include <map>
 #include <mutex>
+#include <set>
 #include <shared_mutex>
+#include <sstream>
 #include <stdexcept>
+#include <thread>
 #include <tuple>
 #include <vector>
 
 #include <core/core.h>
+#include <core/filters.h>
 #include <core/http/http.h>
+#include <core/prefs.h>
 #include <json/json.h>
 #include <nonbiri/cache.h>
+#include <nonbiri/log.h>
 #include <nonbiri/manager.h>
+#include <nonbiri/metrics.h>
+#include <nonbiri/models/update.h>
 #include <nonbiri/utility.h>
 
 namespace fs = std::filesystem;
@@ -20,6 +33,49 @@ static const std::string dataBaseUrl {
 };
 Manager *App::manager {nullptr};
 
+static Metrics::Histogram &methodDuration(const std::string &method)
+{
+  return Metrics::histogram("nonbiri_manager_duration_seconds", {{"method", method}});
+}
+
+struct ExtensionMetrics
+{
+  Metrics::Histogram &duration;
+  Metrics::Counter &errors;
+};
+
+// Looked up in the registry once per domain and method on each thread
+static const ExtensionMetrics &extensionMetrics(const std::string &domain, const std::string &method)
+{
+  thread_local std::map<std::pair<std::string, std::string>, ExtensionMetrics> instruments {};
+  auto it = instruments.find({domain, method});
+  if (it == instruments.end()) {
+    const Metrics::Labels labels {{"domain", domain}, {"method", method}};
+    it = instruments
+           .emplace(std::pair(domain, method),
+             ExtensionMetrics {
+               Metrics::histogram("nonbiri_extension_duration_seconds", labels),
+               Metrics::counter("nonbiri_extension_errors_total", labels),
+             })
+           .first;
+  }
+  return it->second;
+}
+
+// Runs fn, recording how long the extension took and whether it threw.
+template<class Fn>
+static auto measure(const Extension &ext, const std::string &method, Fn fn)
+{
+  const auto &metrics = extensionMetrics(ext.domain, method);
+  Metrics::Timer timer(metrics.duration);
+  try {
+    return fn();
+  } catch (...) {
+    metrics.errors.increment();
+    throw;
+  }
+}
+
 Extension *createExtension(void *handle)
 {
   auto initialize = (Core::initialize_t)Utils::getSymbol(handle, "initialize");
@@ -40,49 +96,202 @@ Extension *createExtension(void *handle)
   return extension;
 }
 
-Manager::Manager(const std::string &dir) : extensionsDir {dir}
+// The library stays loaded for as long as anyone holds the instance.
+static std::shared_ptr<Extension> makeInstance(void *handle, Extension *ext)
 {
-  std::cout << "Initializing manager..." << std::endl;
-  const auto paths = getLocalExtensionPaths();
-  for (const auto &path : paths) {
-    try {
-      loadExtension(path);
-    } catch (const std::exception &e) {
-      std::cerr << "Error loading extension from " << path << ": " << e.what() << std::endl;
+  return std::shared_ptr<Extension>(ext, [handle](Extension *ext) {
+    delete ext;
+    if (handle != nullptr)
+      Utils::freeLibrary(handle);
+  });
+}
+
+// Null if the file cannot be looked at
+static Json::Value fingerprint(const std::string &path)
+{
+  std::error_code error {};
+  const auto size = fs::file_size(path, error);
+  if (error)
+    return {};
+  const auto modified = fs::last_write_time(path, error);
+  if (error)
+    return {};
+
+  Json::Value json {};
+  json["size"] = static_cast<Json::UInt64>(size);
+  json["modified"] = static_cast<Json::Int64>(modified.time_since_epoch().count());
+  return json;
+}
+
+Manager::Manager(const std::string &dir, const std::optional<Sandbox::Options> &isolation) :
+  extensionsDir {dir},
+  isolation {isolation},
+  registry {std::make_shared<const Registry>()}
+{
+  LOG_INFO("Initializing manager...");
+  const auto start = std::chrono::steady_clock::now();
+
+  // Extensions whose library hasn't changed since it was last seen are only
+  // registered from the catalog, they get loaded on first use.
+  const auto catalog = readCatalog();
+  std::vector<std::string> paths {};
+  size_t deferred {};
+
+  for (const auto &path : getLocalExtensionPaths()) {
+    const auto &cached = catalog[path];
+    // Lookups in anything but an object throw, the library is loaded instead
+    if (!cached.isNull() && !cached.isObject()) {
+      LOG_WARN("Ignoring malformed catalog entry of " << path);
+      paths.push_back(path);
+      continue;
+    }
+    if (cached["isStale"].asBool()) {
+      std::error_code error {};
+      if (!fs::remove(path, error))
+        staleFiles.insert(path);
+      continue;
+    }
+
+    const auto current = fingerprint(path);
+    if (cached.isObject() && cached["size"] == current["size"] && cached["modified"] == current["modified"]) {
+      auto entry = std::make_shared<Entry>();
+      entry->path = path;
+      entry->info.domain = cached["domain"].asString();
+      entry->info.name = cached["name"].asString();
+      entry->info.description = cached["description"].asString();
+      entry->info.language = cached["language"].asString();
+      entry->info.version = cached["version"].asString();
+      entry->info.isNsfw = cached["isNsfw"].asBool();
+      entry->hasFilters = cached["hasFilters"].asBool();
+      entry->hasPrefs = cached["hasPrefs"].asBool();
+
+      try {
+        publish(entry, false);
+        deferred++;
+      } catch (const std::exception &e) {
+        LOG_ERROR("Error registering extension from " << path << ": " << e.what());
+      }
+    } else {
+      paths.push_back(path);
     }
   }
+
+  struct Result
+  {
+    void *handle {};
+    Extension *ext {};
+    std::chrono::duration<double, std::milli> elapsed {};
+    std::string error {};
+  };
+  std::vector<Result> results(paths.size());
+
+  // Symbol resolution and extension constructors dominate startup, so they
+  // run on a small pool. Registration happens afterwards, in path order, so
+  // duplicates resolve the same way a sequential load would.
+  std::atomic<size_t> next {};
+  const size_t workerCount = std::min<size_t>(paths.size(), std::max(1U, std::thread::hardware_concurrency()));
+  std::vector<std::thread> workers {};
+  for (size_t i = 0; i < workerCount; i++) {
+    workers.emplace_back([&] {
+      for (size_t j = next++; j < paths.size(); j = next++) {
+        auto &result = results[j];
+        const auto begin = std::chrono::steady_clock::now();
+        try {
+          std::tie(result.handle, result.ext) = openExtension(paths[j]);
+        } catch (const std::exception &e) {
+          result.error = e.what();
+        }
+        result.elapsed = std::chrono::steady_clock::now() - begin;
+      }
+    });
+  }
+  for (auto &worker : workers)
+    worker.join();
+
+  for (size_t i = 0; i < paths.size(); i++) {
+    auto &[handle, ext, elapsed, error] = results[i];
+    if (ext != nullptr) {
+      const auto entry = makeEntry(paths[i], handle, ext);
+      try {
+        publish(entry, false);
+        Metrics::histogram("nonbiri_extension_load_seconds", {{"domain", entry->info.domain}})
+          .observe(std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+        LOG_INFO("Loaded " << entry->info.name << " v" << entry->info.version << " in " << elapsed.count() << "ms");
+        continue;
+      } catch (const std::exception &e) {
+        error = e.what();
+      }
+    }
+    LOG_ERROR("Error loading extension from " << paths[i] << ": " << error);
+  }
+
+  writeCatalog();
+
+  const std::chrono::duration<double, std::milli> total = std::chrono::steady_clock::now() - start;
+  LOG_INFO("Registered " << registry.load()->size() << " extensions (" << deferred << " deferred) in " << total.count()
+                         << "ms using " << workerCount << " threads");
 }
 
 Manager::~Manager()
 {
-  std::cout << "Manager::~Manager()" << std::endl;
+  LOG_DEBUG("Manager::~Manager()");
 }
 
-Extension *Manager::getExtension(const std::string &domain)
+std::shared_ptr<Extension> Manager::getExtension(const std::string &domain)
 {
-  std::shared_lock lock(extensionsMutex);
-  auto it = extensions.find(domain);
-  if (it == extensions.end())
+  static auto &loads = Metrics::counter("nonbiri_extension_lazy_loads_total");
+  const auto current = registry.load();
+  const auto it = current->find(domain);
+  if (it == current->end())
     return nullptr;
-  return it->second;
+
+  const auto &entry = it->second;
+  entry->lastUsed.store(time(nullptr), std::memory_order_relaxed);
+  if (auto instance = entry->instance.load())
+    return instance;
+
+  std::lock_guard lock(entry->loadMutex);
+  if (auto instance = entry->instance.load())
+    return instance;
+
+  const auto [handle, ext] = openExtension(entry->path);
+  auto instance = makeInstance(handle, ext);
+  if (instance->domain != domain)
+    throw std::runtime_error("Extension library no longer matches " + domain);
+
+  instance->hasUpdate.store(entry->hasUpdate.load());
+  entry->instance.store(instance);
+  loads.increment();
+  LOG_INFO("Loaded " << instance->name << " v" << instance->version << " on demand");
+  return instance;
 }
 
-const std::map<std::string, Extension *> &Manager::getExtensions()
+std::map<std::string, Manager::Installed> Manager::getExtensions()
 {
-  std::shared_lock lock(extensionsMutex);
-  return extensions;
+  std::map<std::string, Installed> result {};
+  for (const auto &[domain, entry] : *registry.load()) {
+    Installed installed {};
+    installed.path = entry->path;
+    installed.info = entry->info;
+    installed.hasFilters = entry->hasFilters;
+    installed.hasPrefs = entry->hasPrefs;
+    installed.hasUpdate = entry->hasUpdate.load();
+    installed.isLoaded = entry->instance.load() != nullptr;
+    result.emplace(domain, installed);
+  }
+  return result;
 }
 
-const ExtensionInfo *Manager::getExtensionInfo(const std::string &domain)
+std::optional<ExtensionInfo> Manager::getExtensionInfo(const std::string &domain)
 {
   std::shared_lock lock(indexesMutex);
   auto it = indexes.find(domain);
   if (it == indexes.end())
-    return nullptr;
-  return &it->second;
+    return std::nullopt;
+  return it->second;
 }
 
-const std::map<std::string, ExtensionInfo> &Manager::getIndexes()
+std::map<std::string, ExtensionInfo> Manager::getIndexes()
 {
   std::shared_lock lock(indexesMutex);
   return indexes;
@@ -90,54 +299,102 @@ const std::map<std::string, ExtensionInfo> &Manager::getIndexes()
 
 void Manager::loadExtension(const std::string &path)
 {
-  std::lock_guard lock(extensionsMutex);
-  std::lock_guard lock2(handlesMutex);
+  const auto [handle, ext] = openExtension(path);
+  const auto entry = makeEntry(path, handle, ext);
+  publish(entry, false);
+  LOG_INFO("Loaded " << entry->info.name << " v" << entry->info.version);
+  writeCatalog();
+}
 
-  std::cout << "Loading " << path << std::endl;
+std::tuple<void *, Extension *> Manager::openExtension(const std::string &path)
+{
+  LOG_INFO("Loading " << path);
   if (!fs::exists(path))
     throw std::runtime_error("Extension not found");
 
+  if (isolation.has_value())
+    return {nullptr, new Sandbox::IsolatedExtension(path, *isolation)};
+
   auto handle = Utils::loadLibrary(path);
   if (handle == nullptr)
     throw std::runtime_error("Unable to load extension");
 
-  auto ext = createExtension(handle);
-  if (extensions.find(ext->domain) != extensions.end()) {
+  try {
+    return {handle, createExtension(handle)};
+  } catch (...) {
     Utils::freeLibrary(handle);
-    throw std::runtime_error("Extension already loaded");
+    throw;
   }
+}
 
-  const auto info = getExtensionInfo(ext->domain);
-  ext->hasUpdate.store(info != nullptr && ext->version != info->version);
+std::shared_ptr<Manager::Entry> Manager::makeEntry(const std::string &path, void *handle, Extension *ext)
+{
+  auto entry = std::make_shared<Entry>();
+  const auto instance = makeInstance(handle, ext);
+  entry->path = path;
+  entry->info = *ext;
+  const auto isolated = dynamic_cast<const Sandbox::IsolatedExtension *>(ext);
+  entry->hasFilters = dynamic_cast<const Filters *>(ext) != nullptr || (isolated != nullptr && isolated->hasFilters);
+  entry->hasPrefs = dynamic_cast<const Prefs *>(ext) != nullptr || (isolated != nullptr && isolated->hasPrefs);
+  entry->lastUsed.store(time(nullptr));
+  entry->instance.store(instance);
+  return entry;
+}
 
-  extensions.insert(std::make_pair(ext->domain, ext));
-  handles.insert(std::make_pair(ext->domain, handle));
-  std::cout << "Loaded " << ext->name << " v" << ext->version << std::endl;
+void Manager::publish(const std::shared_ptr<Entry> &entry, bool replace)
+{
+  const auto info = getExtensionInfo(entry->info.domain);
+  entry->hasUpdate.store(info.has_value() && entry->info.version != info->version);
+  if (const auto instance = entry->instance.load())
+    instance->hasUpdate.store(entry->hasUpdate.load());
+
+  std::lock_guard lock(registryMutex);
+  auto next = std::make_shared<Registry>(*registry.load());
+  if (!replace && next->find(entry->info.domain) != next->end())
+    throw std::runtime_error("Extension already loaded");
+
+  (*next)[entry->info.domain] = entry;
+  registry.store(next);
 }
 
 void Manager::unloadExtension(const std::string &domain)
 {
-  std::lock_guard lock(extensionsMutex);
-  std::lock_guard lock2(handlesMutex);
+  std::shared_ptr<Entry> entry {};
+  {
+    std::lock_guard lock(registryMutex);
+    auto next = std::make_shared<Registry>(*registry.load());
+    auto it = next->find(domain);
+    if (it == next->end())
+      throw std::runtime_error("Extension not loaded");
+
+    entry = it->second;
+    next->erase(it);
+    registry.store(next);
+  }
 
-  auto ext = extensions.find(domain);
-  if (ext == extensions.end())
-    throw std::runtime_error("Extension not loaded");
+  // In-flight requests keep their own reference, the library is released
+  // once the last of them finishes.
+  LOG_INFO("Unloaded " << entry->info.name << " v" << entry->info.version);
+  writeCatalog();
+}
 
-  const auto name = ext->second->name;
-  const auto version = ext->second->version;
-  std::cout << "Unloading " << name << " v" << version << std::endl;
+void Manager::unloadIdleExtensions(time_t ttl)
+{
+  static auto &unloads = Metrics::counter("nonbiri_extension_idle_unloads_total");
+  const time_t now {time(nullptr)};
 
-  auto handle = handles.find(domain);
-  if (handle == handles.end())
-    throw std::runtime_error("Extension not loaded");
+  for (const auto &[domain, entry] : *registry.load()) {
+    if (entry->instance.load() == nullptr || now - entry->lastUsed.load() < ttl)
+      continue;
 
-  delete ext->second;
-  extensions.erase(ext);
+    std::lock_guard lock(entry->loadMutex);
+    if (now - entry->lastUsed.load() < ttl)
+      continue;
 
-  Utils::freeLibrary(handle->second);
-  handles.erase(handle);
-  std::cout << "Unloaded " << name << " v" << version << std::endl;
+    entry->instance.store(nullptr);
+    unloads.increment();
+    LOG_INFO("Unloaded idle " << entry->info.name << " v" << entry->info.version);
+  }
 }
 
 void Manager::downloadExtension(const std::string &domain, bool update)
@@ -149,52 +406,104 @@ void Manager::downloadExtension(const std::string &domain, bool update)
     fs::create_directory(extensionsDir);
 
   const auto info = getExtensionInfo(domain);
-  if (info == nullptr)
+  if (!info)
     throw std::runtime_error("Extension not found");
 
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
-  const std::string fileName {domain + ".dll"};
+  static const std::string suffix {".dll"};
 #else
-  const std::string fileName {domain + ".so"};
+  static const std::string suffix {".so"};
 #endif
 
-  const auto path = (fs::path(extensionsDir) / fileName).string();
-  if (fs::exists(path)) {
-    if (!update)
+  std::string previous {};
+  {
+    const auto current = registry.load();
+    const auto it = current->find(domain);
+    if (it != current->end() && !update)
       throw std::runtime_error("Extension already installed");
-    removeExtension(domain);
+    if (it != current->end())
+      previous = it->second->path;
+  }
+
+  // Every download gets a file name of its own. The loader never mistakes it
+  // for the library in-flight requests may still be running, and the old one
+  // is left alone until the new one is published, which Windows requires
+  // while it is loaded.
+  std::string path {};
+  for (int n = 0; path.empty() || fs::exists(path) || fs::exists(path + ".download"); n++) {
+    const auto name = domain + "-" + info->version + (n > 0 ? "-" + std::to_string(n) : "") + suffix;
+    path = (fs::path(extensionsDir) / name).string();
   }
 
-  std::cout << "Downloading " << info->name << "..." << std::endl;
-  int code = Http::download(dataBaseUrl + "/" + info->path, path);
-  if (code != 200)
+  const std::string tmp {path + ".download"};
+  LOG_INFO("Downloading " << info->name << "...");
+  int code = Http::download(dataBaseUrl + "/" + info->path, tmp);
+  std::error_code error {};
+  if (code != 200) {
+    fs::remove(tmp, error);
     throw std::runtime_error("Unable to download extension");
+  }
+  fs::rename(tmp, path, error);
+  if (error) {
+    fs::remove(tmp, error);
+    throw std::runtime_error("Unable to save extension");
+  }
 
-  loadExtension(path);
+  std::shared_ptr<Entry> entry {};
+  try {
+    const auto [handle, ext] = openExtension(path);
+    entry = makeEntry(path, handle, ext);
+    if (entry->info.domain != domain)
+      throw std::runtime_error("Downloaded extension does not match " + domain);
+    publish(entry, update);
+  } catch (...) {
+    // Nothing else holds the new library, it is unloaded before removal
+    entry.reset();
+    fs::remove(path, error);
+    throw;
+  }
+
+  if (!previous.empty())
+    removeLibrary(previous);
+  LOG_INFO((update ? "Updated " : "Installed ") << entry->info.name << " v" << entry->info.version);
+  writeCatalog();
 }
 
 void Manager::removeExtension(const std::string &domain, fs::path path)
 {
-  if (getExtensionInfo(domain) == nullptr)
+  if (!getExtensionInfo(domain))
     throw std::runtime_error("Extension not found");
 
+  if (path.empty()) {
+    const auto current = registry.load();
+    const auto it = current->find(domain);
+    if (it == current->end())
+      throw std::runtime_error("Extension not installed");
+    path = it->second->path;
+  }
+
   try {
     unloadExtension(domain);
   } catch (const std::exception &e) {
-    std::cerr << "Error unloading extension: " << e.what() << std::endl;
+    LOG_ERROR("Error unloading extension: " << e.what());
   }
 
-  if (path.empty()) {
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
-    const std::string localName {domain + ".dll"};
-#else
-    const std::string localName {domain + ".so"};
-#endif
-    path = fs::absolute(fs::path(extensionsDir) / localName);
+  if (fs::exists(path)) {
+    removeLibrary(path.string());
+    writeCatalog();
   }
+}
 
-  if (fs::exists(path))
-    fs::remove(path);
+void Manager::removeLibrary(const std::string &path)
+{
+  // Fails on Windows while in-flight requests still run the library
+  std::error_code error {};
+  fs::remove(path, error);
+  if (error) {
+    LOG_WARN("Removing " << path << " on next start: " << error.message());
+    std::lock_guard lock(catalogMutex);
+    staleFiles.insert(path);
+  }
 }
 
 int Manager::downloadIcon(const std::string &fileName, const std::string &outputPath)
@@ -212,14 +521,15 @@ void Manager::updateExtension(const std::string &domain)
 
 void Manager::updateExtensionIndexes()
 {
-  std::lock_guard lock(indexesMutex);
-
   const time_t now {time(nullptr)};
-  const double minutes {difftime(now, indexLastUpdated) / 60.0};
+  time_t lastUpdated {indexLastUpdated.load()};
+  const double minutes {difftime(now, lastUpdated) / 60.0};
 
   if (minutes > 0 && minutes <= 10.0)
     return;
-  indexLastUpdated = now;
+  // Only one caller goes on to download, readers keep the old index meanwhile
+  if (!indexLastUpdated.compare_exchange_strong(lastUpdated, now))
+    return;
 
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
   static const std::string url {dataBaseUrl + "/windows.json"};
@@ -236,9 +546,17 @@ void Manager::updateExtensionIndexes()
 
   if (!reader.parse(res->body, root))
     throw std::runtime_error("Unable to parse extensions index: " + reader.getFormattedErrorMessages());
+  if (!root.isObject())
+    throw std::runtime_error("Unable to parse extensions index: not an object");
 
+  std::map<std::string, ExtensionInfo> fetched {};
   for (const auto &domain : root.getMemberNames()) {
     const auto &json = root[domain];
+    if (!json.isObject()) {
+      LOG_WARN("Ignoring malformed index entry of " << domain);
+      continue;
+    }
+
     ExtensionInfo info {};
     info.domain = domain;
     info.name = json["name"].asString();
@@ -247,18 +565,33 @@ void Manager::updateExtensionIndexes()
     info.version = json["version"].asString();
     info.isNsfw = json["isNsfw"].asBool();
     info.path = json["path"].asString();
-    indexes.emplace(domain, info);
+    fetched[domain] = info;
+  }
 
-    auto ext = getExtension(domain);
-    if (ext != nullptr)
-      ext->hasUpdate.store(ext->version != info.version);
+  {
+    std::lock_guard lock(indexesMutex);
+    for (const auto &[domain, info] : fetched)
+      indexes[domain] = info;
+  }
+
+  for (const auto &[domain, entry] : *registry.load()) {
+    const auto it = fetched.find(domain);
+    if (it == fetched.end())
+      continue;
+
+    entry->hasUpdate.store(entry->info.version != it->second.version);
+    if (const auto instance = entry->instance.load())
+      instance->hasUpdate.store(entry->hasUpdate.load());
   }
 }
 
 std::tuple<std::vector<std::shared_ptr<Manga>>, bool> Manager::getLatests(Extension &ext, int page)
 {
   Utils::ExecTime execTime("Manager::getLatests(ext, page)");
-  const auto &[entries, hasNext] = ext.getLatests(page);
+  static auto &duration = methodDuration("getLatests");
+  Metrics::Timer timer(duration);
+
+  const auto &[entries, hasNext] = measure(ext, "getLatests", [&] { return ext.getLatests(page); });
 
   std::vector<std::shared_ptr<Manga>> manga {};
   for (const auto &e : entries) {
@@ -273,7 +606,10 @@ std::tuple<std::vector<std::shared_ptr<Manga>>, bool> Manager::searchManga(
   Extension &ext, int page, const std::string &query, const std::vector<std::pair<std::string, std::string>> &filters)
 {
   Utils::ExecTime execTime("Manager::searchManga(ext, page, query, filters)");
-  const auto &[entries, hasNext] = ext.searchManga(page, query, filters);
+  static auto &duration = methodDuration("searchManga");
+  Metrics::Timer timer(duration);
+
+  const auto &[entries, hasNext] = measure(ext, "searchManga", [&] { return ext.searchManga(page, query, filters); });
 
   std::vector<std::shared_ptr<Manga>> manga {};
   for (const auto &e : entries) {
@@ -284,16 +620,74 @@ std::tuple<std::vector<std::shared_ptr<Manga>>, bool> Manager::searchManga(
   return {manga, hasNext};
 }
 
+std::optional<Json::Value> Manager::getFilters(Extension &ext)
+{
+  if (const auto isolated = dynamic_cast<Sandbox::IsolatedExtension *>(&ext))
+    return isolated->hasFilters ? std::optional(isolated->getFilters()) : std::nullopt;
+
+  const auto filters = dynamic_cast<const Filters *>(&ext);
+  if (filters == nullptr)
+    return std::nullopt;
+
+  Json::Value root(Json::arrayValue);
+  for (const auto &filter : filters->list()) {
+    if (dynamic_cast<const Filter::Hidden *>(filter.get()) == nullptr)
+      root.append(filter->toJson());
+  }
+  return root;
+}
+
+std::optional<std::set<std::string>> Manager::getFilterKeys(Extension &ext)
+{
+  if (const auto isolated = dynamic_cast<Sandbox::IsolatedExtension *>(&ext))
+    return isolated->hasFilters ? std::optional(isolated->getFilterKeys()) : std::nullopt;
+
+  const auto filters = dynamic_cast<const Filters *>(&ext);
+  if (filters == nullptr)
+    return std::nullopt;
+
+  std::set<std::string> keys {};
+  for (const auto &[key, _] : filters->index())
+    keys.insert(key);
+  return keys;
+}
+
+std::optional<Json::Value> Manager::getPrefs(Extension &ext)
+{
+  if (const auto isolated = dynamic_cast<Sandbox::IsolatedExtension *>(&ext))
+    return isolated->hasPrefs ? std::optional(isolated->getPrefs()) : std::nullopt;
+
+  const auto prefs = dynamic_cast<const Prefs *>(&ext);
+  if (prefs == nullptr)
+    return std::nullopt;
+  return prefs->toJson();
+}
+
+std::optional<Json::Value> Manager::setPrefs(Extension &ext, const Json::Value &payload)
+{
+  if (const auto isolated = dynamic_cast<Sandbox::IsolatedExtension *>(&ext))
+    return isolated->hasPrefs ? std::optional(isolated->setPrefs(payload)) : std::nullopt;
+
+  const auto prefs = dynamic_cast<Prefs *>(&ext);
+  if (prefs == nullptr)
+    return std::nullopt;
+  prefs->update(payload);
+  return prefs->toJson();
+}
+
 std::shared_ptr<Manga> Manager::getManga(Extension &ext, const std::string &path)
 {
   Utils::ExecTime execTime("Manager::getManga(ext, path)");
+  static auto &duration = methodDuration("getManga");
+  Metrics::Timer timer(duration);
+
   const auto cacheKey {ext.domain + path};
-  if (Cache::manga.has(cacheKey)) {
-    const auto manga = Cache::manga.get(cacheKey);
-    if (manga->id > 0)
+  const auto cached = Cache::manga.get(cacheKey);
+  if (cached != nullptr) {
+    if (cached->id > 0)
       Cache::manga.remove(cacheKey);
     else
-      return manga;
+      return cached;
   }
 
   try {
@@ -301,16 +695,16 @@ std::shared_ptr<Manga> Manager::getManga(Extension &ext, const std::string &path
     if (manga != nullptr)
       return manga;
   } catch (const std::exception &e) {
-    std::cerr << "Unable to get manga: " << e.what() << std::endl;
+    LOG_ERROR("Unable to get manga: " << e.what());
   }
 
   std::shared_ptr<Manga> manga {nullptr};
   try {
-    const auto m = ext.getManga(path);
+    const auto m = measure(ext, "getManga", [&] { return ext.getManga(path); });
     if (m != nullptr)
       manga = std::make_shared<Manga>(ext.domain, *m);
   } catch (const std::exception &e) {
-    std::cerr << "Unable to fetch manga: " << e.what() << std::endl;
+    LOG_ERROR("Unable to fetch manga: " << e.what());
   }
 
   if (manga != nullptr)
@@ -330,34 +724,36 @@ std::vector<std::shared_ptr<Chapter>> Manager::getChapters(Extension &ext, const
 std::vector<std::shared_ptr<Chapter>> Manager::getChapters(Extension &ext, Manga &manga)
 {
   Utils::ExecTime execTime("Manager::getChapters(ext, manga)");
+  static auto &duration = methodDuration("getChapters");
+  Metrics::Timer timer(duration);
   try {
     const auto chapters = manga.getChapters();
     if (!chapters.empty())
       return chapters;
   } catch (const std::exception &e) {
-    std::cerr << "Unable to get chapters: " << e.what() << std::endl;
+    LOG_ERROR("Unable to get chapters: " << e.what());
   }
 
   const auto cacheKey {ext.domain + manga.path};
-  if (Cache::chapters.has(cacheKey)) {
-    const auto chapters = Cache::chapters.get(cacheKey);
+  const auto cached = Cache::chapters.get(cacheKey);
+  if (!cached.empty()) {
     if (manga.id > 0) {
-      Chapter::saveAll(chapters, manga.id);
+      Chapter::saveAll(cached, manga.id);
       Cache::chapters.remove(cacheKey);
-      return getChapters(ext, manga);
+      return manga.getChapters();
     }
-    return chapters;
+    return cached;
   }
 
   std::vector<std::shared_ptr<Chapter>> chapters {};
   try {
-    const auto entries = ext.getChapters(manga.path);
+    const auto entries = measure(ext, "getChapters", [&] { return ext.getChapters(manga.path); });
     for (const auto &e : entries) {
       const auto entry = std::make_shared<Chapter>(manga.id, ext.domain, *e);
       chapters.push_back(entry);
     }
   } catch (const std::exception &e) {
-    std::cerr << "Unable to fetch chapters: " << e.what() << std::endl;
+    LOG_ERROR("Unable to fetch chapters: " << e.what());
   }
 
   if (manga.id > 0)
@@ -367,19 +763,165 @@ std::vector<std::shared_ptr<Chapter>> Manager::getChapters(Extension &ext, Manga
   return chapters;
 }
 
-std::vector<std::string> Manager::getPages(Extension &ext, const std::string &path)
+std::vector<std::shared_ptr<Chapter>> Manager::updateChapters(Extension &ext, Manga &manga)
 {
-  Utils::ExecTime execTime("Manager::getPages(ext, path)");
-  return ext.getPages(path);
+  Utils::ExecTime execTime("Manager::updateChapters(ext, manga)");
+  static auto &duration = methodDuration("updateChapters");
+  Metrics::Timer timer(duration);
+  if (manga.id <= 0)
+    throw std::runtime_error("Only library titles can be updated");
+
+  std::map<std::string, std::shared_ptr<Chapter>> stored {};
+  for (const auto &chapter : Chapter::findAll(manga.id))
+    stored[chapter->path] = chapter;
+
+  // Chapters the source took down are kept, along with what was read of them
+  std::vector<std::shared_ptr<Chapter>> chapters {};
+  std::set<std::string> listed {};
+  const auto entries = measure(ext, "getChapters", [&] { return ext.getChapters(manga.path); });
+  for (const auto &e : entries) {
+    if (listed.insert(e->path).second && stored.find(e->path) == stored.end())
+      chapters.push_back(std::make_shared<Chapter>(manga.id, ext.domain, *e));
+  }
+
+  Update::addAll(manga, chapters);
+  return chapters;
+}
+
+std::vector<std::string> Manager::getPages(Extension &ext, const std::string &path, bool refresh)
+{
+  Utils::ExecTime execTime("Manager::getPages(ext, path, refresh)");
+  static auto &duration = methodDuration("getPages");
+  Metrics::Timer timer(duration);
+
+  // Chapters in the library keep their pages until the reader asks for a
+  // refresh because an image failed. The others are cached until their image
+  // URLs may have expired.
+  std::shared_ptr<Chapter> chapter {nullptr};
+  try {
+    chapter = Chapter::find(ext.domain, path);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Unable to get chapter: " << e.what());
+  }
+
+  const auto cacheKey {ext.domain + path};
+  std::vector<std::string> pages {};
+  if (!refresh) {
+    if (chapter != nullptr && !chapter->pages.empty())
+      return chapter->pages;
+    pages = Cache::pages.get(cacheKey);
+    if (!pages.empty() && chapter == nullptr)
+      return pages;
+  }
+
+  // A chapter added to the library since its pages were cached takes them over
+  if (pages.empty())
+    pages = measure(ext, "getPages", [&] { return ext.getPages(path); });
+  if (pages.empty())
+    return pages;
+
+  if (chapter != nullptr) {
+    chapter->pages = pages;
+    try {
+      chapter->savePages();
+      Cache::pages.remove(cacheKey);
+    } catch (const std::exception &e) {
+      LOG_ERROR("Unable to save pages: " << e.what());
+    }
+  } else {
+    Cache::pages.set(cacheKey, pages);
+  }
+  return pages;
 }
 
 std::vector<std::string> Manager::getLocalExtensionPaths()
 {
   if (!fs::exists(extensionsDir))
     return {};
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+  static const std::string suffix {".dll"};
+#else
+  static const std::string suffix {".so"};
+#endif
+
   std::vector<std::string> result {};
   for (const auto &dirEntry : fs::recursive_directory_iterator(extensionsDir))
-    if (dirEntry.is_regular_file())
+    if (dirEntry.is_regular_file() && dirEntry.path().extension() == suffix)
       result.push_back(dirEntry.path().string());
   return result;
 }
+
+Json::Value Manager::readCatalog()
+{
+  std::lock_guard lock(catalogMutex);
+  const auto path = fs::path(extensionsDir) / "catalog.json";
+
+  Json::Value root {};
+  std::ifstream file(path);
+  if (!file.is_open())
+    return root;
+
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+
+  Json::Reader reader {};
+  if (!reader.parse(buffer.str(), root)) {
+    LOG_WARN("Ignoring unreadable extension catalog: " << reader.getFormattedErrorMessages());
+    return Json::Value {};
+  }
+  // Lookups by path would throw on anything else
+  if (!root.isObject()) {
+    LOG_WARN("Ignoring malformed extension catalog");
+    return Json::Value {};
+  }
+  return root;
+}
+
+void Manager::writeCatalog()
+{
+  // Only ever a startup shortcut, failing to write it must not fail the
+  // change that asked for it
+  Json::Value root {Json::objectValue};
+  for (const auto &[domain, meta] : getExtensions()) {
+    Json::Value json = fingerprint(meta.path);
+    if (json.isNull())
+      continue;
+    json["domain"] = meta.info.domain;
+    json["name"] = meta.info.name;
+    json["description"] = meta.info.description;
+    json["language"] = meta.info.language;
+    json["version"] = meta.info.version;
+    json["isNsfw"] = meta.info.isNsfw;
+    json["hasFilters"] = meta.hasFilters;
+    json["hasPrefs"] = meta.hasPrefs;
+    root[meta.path] = json;
+  }
+
+  std::lock_guard lock(catalogMutex);
+  std::error_code error {};
+  if (!fs::exists(extensionsDir, error))
+    return;
+  for (const auto &path : staleFiles)
+    root[path]["isStale"] = true;
+
+  const auto path = fs::path(extensionsDir) / "catalog.json";
+  const auto tmp = fs::path(extensionsDir) / "catalog.json.tmp";
+  {
+    std::ofstream file(tmp, std::ios::out | std::ios::trunc);
+    Json::FastWriter writer {};
+    file << writer.write(root);
+    file.close();
+    if (!file.good()) {
+      LOG_ERROR("Unable to write " << tmp.string());
+      fs::remove(tmp, error);
+      return;
+    }
+  }
+
+  fs::rename(tmp, path, error);
+  if (error) {
+    LOG_ERROR("Unable to write " << path.string() << ": " << error.message());
+    fs::remove(tmp, error);
+  }
+}
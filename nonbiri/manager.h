@@ -5,42 +5,84 @@
 #include <filesystem>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <shared_mutex>
 #include <string>
 #include <tuple>
 #include <vector>
 
 #include <core/extension.h>
+#include <json/json.h>
 #include <nonbiri/models/chapter.h>
 #include <nonbiri/models/manga.h>
+#include <nonbiri/sandbox.h>
 
 class Manager
 {
+public:
+  struct Installed
+  {
+    std::string path {};
+    ExtensionInfo info {};
+    bool hasFilters {};
+    bool hasPrefs {};
+    bool hasUpdate {};
+    bool isLoaded {};
+  };
+
+private:
+  // An installed extension, immutable once published apart from the atomics.
+  // Its library is only loaded while it is in use, callers keep it alive by
+  // holding on to the instance.
+  struct Entry
+  {
+    std::string path {};
+    ExtensionInfo info {};
+    bool hasFilters {};
+    bool hasPrefs {};
+
+    std::atomic<bool> hasUpdate {};
+    std::atomic<time_t> lastUsed {};
+    std::atomic<std::shared_ptr<Extension>> instance {};
+    std::mutex loadMutex {};
+  };
+  using Registry = std::map<std::string, std::shared_ptr<Entry>>;
+
   const std::string extensionsDir;
+  // Set when extensions run in worker processes
+  const std::optional<Sandbox::Options> isolation;
   std::atomic<time_t> indexLastUpdated;
 
-  std::map<std::string, Extension *> extensions;
-  std::shared_mutex extensionsMutex;
-
-  std::map<std::string, void *> handles;
-  std::shared_mutex handlesMutex;
+  // Readers take the current snapshot without locking. Writers copy it under
+  // registryMutex and publish the copy, replaced snapshots and entries are
+  // freed by whichever reader lets go of them last.
+  std::atomic<std::shared_ptr<const Registry>> registry;
+  std::mutex registryMutex;
+  std::mutex catalogMutex;
+  // Old libraries that were still loaded when replaced or removed, they go
+  // on the next start. Guarded by catalogMutex.
+  std::set<std::string> staleFiles;
 
   std::map<std::string, ExtensionInfo> indexes;
   std::shared_mutex indexesMutex;
 
 public:
-  Manager(const std::string &dir = "extensions");
+  Manager(const std::string &dir = "extensions", const std::optional<Sandbox::Options> &isolation = std::nullopt);
   ~Manager();
   void reset();
 
   //
-  Extension *getExtension(const std::string &domain);
-  const std::map<std::string, Extension *> &getExtensions();
-  const ExtensionInfo *getExtensionInfo(const std::string &domain);
-  const std::map<std::string, ExtensionInfo> &getIndexes();
+  std::shared_ptr<Extension> getExtension(const std::string &domain);
+  std::map<std::string, Installed> getExtensions();
+  // Copies, the index may be replaced by updateExtensionIndexes at any time
+  std::optional<ExtensionInfo> getExtensionInfo(const std::string &domain);
+  std::map<std::string, ExtensionInfo> getIndexes();
 
   void loadExtension(const std::string &path);
   void unloadExtension(const std::string &domain);
+  void unloadIdleExtensions(time_t ttl);
 
   void downloadExtension(const std::string &domain, bool update = false);
   void removeExtension(const std::string &domain, std::filesystem::path path = "");
@@ -53,16 +95,36 @@ public:
   std::tuple<std::vector<std::shared_ptr<Manga>>, bool> getLatests(Extension &ext, int page);
   std::tuple<std::vector<std::shared_ptr<Manga>>, bool> searchManga(
     Extension &ext, int page, const std::string &query, const std::vector<std::pair<std::string, std::string>> &filters);
+  // Filters and prefs of ext, asked of its worker when it runs isolated.
+  // nullopt when it has none.
+  std::optional<Json::Value> getFilters(Extension &ext);
+  std::optional<std::set<std::string>> getFilterKeys(Extension &ext);
+  std::optional<Json::Value> getPrefs(Extension &ext);
+  std::optional<Json::Value> setPrefs(Extension &ext, const Json::Value &prefs);
 
   std::shared_ptr<Manga> getManga(Extension &ext, const std::string &path);
   std::vector<std::shared_ptr<Chapter>> getChapters(Extension &ext, const std::string &path);
   std::vector<std::shared_ptr<Chapter>> getChapters(Extension &ext, Manga &manga);
-  std::vector<std::string> getPages(Extension &ext, const std::string &path);
+  // Asks the source for the chapters of a library title and stores the ones
+  // not seen before, which are returned and added to the updates feed.
+  std::vector<std::shared_ptr<Chapter>> updateChapters(Extension &ext, Manga &manga);
+  // refresh skips stored pages, for when their images no longer load
+  std::vector<std::string> getPages(Extension &ext, const std::string &path, bool refresh = false);
 
 private:
+  std::tuple<void *, Extension *> openExtension(const std::string &path);
+  std::shared_ptr<Entry> makeEntry(const std::string &path, void *handle, Extension *ext);
+  void publish(const std::shared_ptr<Entry> &entry, bool replace);
+  void removeLibrary(const std::string &path);
   std::vector<std::string> getLocalExtensionPaths();
+
+  Json::Value readCatalog();
+  void writeCatalog();
 };
 
+// Creates the extension of a loaded library and hands it the Http functions
+Extension *createExtension(void *handle);
+
 namespace App
 {
 extern Manager *manager;
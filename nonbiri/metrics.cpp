@@ -0,0 +1,204 @@
+#include <bit>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+
+#include <nonbiri/metrics.h>
+
+namespace Metrics
+{
+struct Family
+{
+  std::map<std::string, std::unique_ptr<Counter>> counters {};
+  std::map<std::string, std::unique_ptr<Histogram>> histograms {};
+};
+
+struct Registry
+{
+  std::shared_mutex mutex {};
+  std::map<std::string, Family> families {};
+};
+
+// Metrics are looked up from static initializers (e.g. the caches), so the
+// registry has to be constructed on first use.
+static Registry &registry()
+{
+  static Registry instance {};
+  return instance;
+}
+
+// Upper bounds (in seconds) exported as `le` buckets, the fine grained
+// buckets are folded into these when rendering.
+static constexpr double exportedBounds[] {
+  0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60,
+};
+
+static std::string formatLabels(const Labels &labels)
+{
+  std::string result {};
+  for (const auto &[key, value] : labels) {
+    if (!result.empty())
+      result += ',';
+    result += key + "=\"";
+    for (const char c : value) {
+      if (c == '\\' || c == '"')
+        result += '\\';
+      if (c == '\n')
+        result += "\\n";
+      else
+        result += c;
+    }
+    result += '"';
+  }
+  return result;
+}
+
+template<class T>
+static T &find(std::map<std::string, std::unique_ptr<T>> Family::*series, const std::string &name, const Labels &labels)
+{
+  auto &[mutex, families] = registry();
+  const std::string key {formatLabels(labels)};
+  {
+    std::shared_lock lock(mutex);
+    const auto family = families.find(name);
+    if (family != families.end()) {
+      const auto &map = family->second.*series;
+      const auto it = map.find(key);
+      if (it != map.end())
+        return *it->second;
+    }
+  }
+
+  std::lock_guard lock(mutex);
+  auto &ptr = (families[name].*series)[key];
+  if (ptr == nullptr)
+    ptr = std::make_unique<T>();
+  return *ptr;
+}
+
+uint64_t Counter::get() const
+{
+  return value.load(std::memory_order_relaxed);
+}
+
+void Histogram::observe(std::chrono::microseconds duration)
+{
+  const uint64_t value = duration.count() > 0 ? duration.count() : 0;
+  buckets[indexOf(value)].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::getCount() const
+{
+  return count.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::getSum() const
+{
+  return sum.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::cumulative(uint64_t upperBound) const
+{
+  uint64_t result {};
+  for (unsigned int i = 0; i < bucketCount && upperBoundOf(i) - 1 <= upperBound; i++)
+    result += buckets[i].load(std::memory_order_relaxed);
+  return result;
+}
+
+uint64_t Histogram::quantile(double q) const
+{
+  const uint64_t total = getCount();
+  if (total == 0)
+    return 0;
+
+  const auto rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(total)));
+  uint64_t seen {};
+  for (unsigned int i = 0; i < bucketCount; i++) {
+    seen += buckets[i].load(std::memory_order_relaxed);
+    if (seen >= rank)
+      return upperBoundOf(i) - 1;
+  }
+  return upperBoundOf(bucketCount - 1) - 1;
+}
+
+unsigned int Histogram::indexOf(uint64_t value)
+{
+  if (value < subBuckets)
+    return static_cast<unsigned int>(value);
+
+  const unsigned int msb = std::bit_width(value) - 1;
+  const unsigned int index = (msb - 2) * subBuckets + ((value >> (msb - 3)) & (subBuckets - 1));
+  return index < bucketCount ? index : bucketCount - 1;
+}
+
+uint64_t Histogram::upperBoundOf(unsigned int index)
+{
+  if (index < subBuckets)
+    return index + 1;
+
+  const unsigned int msb = index / subBuckets + 2;
+  const uint64_t width = uint64_t {1} << (msb - 3);
+  return (subBuckets + index % subBuckets) * width + width;
+}
+
+Timer::Timer(Histogram &histogram) : histogram {histogram}, start {std::chrono::steady_clock::now()} {}
+
+Timer::~Timer()
+{
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  histogram.observe(std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+}
+
+Counter &counter(const std::string &name, const Labels &labels)
+{
+  return find(&Family::counters, name, labels);
+}
+
+Histogram &histogram(const std::string &name, const Labels &labels)
+{
+  return find(&Family::histograms, name, labels);
+}
+
+std::string render()
+{
+  auto &[mutex, families] = registry();
+  std::shared_lock lock(mutex);
+  std::ostringstream out {};
+
+  for (const auto &[name, family] : families) {
+    if (!family.counters.empty()) {
+      out << "# TYPE " << name << " counter\n";
+      for (const auto &[labels, counter] : family.counters) {
+        out << name;
+        if (!labels.empty())
+          out << '{' << labels << '}';
+        out << ' ' << counter->get() << '\n';
+      }
+    }
+
+    if (!family.histograms.empty()) {
+      out << "# TYPE " << name << " histogram\n";
+      for (const auto &[labels, histogram] : family.histograms) {
+        const std::string prefix {labels.empty() ? "" : labels + ","};
+        for (const double bound : exportedBounds) {
+          const auto micros = static_cast<uint64_t>(bound * 1e6);
+          out << name << "_bucket{" << prefix << "le=\"" << bound << "\"} " << histogram->cumulative(micros) << '\n';
+        }
+
+        const uint64_t total = histogram->cumulative(UINT64_MAX);
+        out << name << "_bucket{" << prefix << "le=\"+Inf\"} " << total << '\n';
+
+        const std::string suffix {labels.empty() ? "" : "{" + labels + "}"};
+        out << name << "_sum" << suffix << ' ' << static_cast<double>(histogram->getSum()) / 1e6 << '\n';
+        out << name << "_count" << suffix << ' ' << total << '\n';
+      }
+    }
+  }
+  return out.str();
+}
+}  // namespace Metrics
@@ -1,3 +1,4 @@
+#include <ctime>
 #include <iostream>
 #include <stdexcept>
 
@@ -113,6 +114,141 @@ void Chapter::save(int64_t mangaId)
     this->mangaId = mangaId;
 }
 
+void Chapter::savePages()
+{
+  Utils::ExecTime execTime("Chapter::savePages");
+  if (id <= 0)
+    throw std::runtime_error("Chapter::savePages(): chapter is not saved");
+
+  static constexpr const char *sql {"UPDATE chapter SET pages = ?, page_count = ? WHERE id = ?"};
+  sqlite3_stmt *stmt = nullptr;
+
+  // JSON rather than Database::serializeArray, page URLs may contain commas
+  Json::Value root(Json::arrayValue);
+  for (const auto &page : pages)
+    root.append(page);
+  Json::FastWriter writer {};
+  const std::string blob {writer.write(root)};
+  pageCount = pages.size();
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_blob(stmt, 1, blob.data(), blob.size(), SQLITE_STATIC);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int(stmt, 2, pageCount);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int64(stmt, 3, id);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (exit != SQLITE_DONE)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+}
+
+void Chapter::setDownloaded(bool isDownloaded)
+{
+  Utils::ExecTime execTime("Chapter::setDownloaded");
+  static constexpr const char *sql {"UPDATE chapter SET downloaded = ?, downloaded_at = ? WHERE id = ?"};
+  sqlite3_stmt *stmt = nullptr;
+  const int64_t now {isDownloaded ? time(nullptr) : 0};
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int(stmt, 1, isDownloaded);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int64(stmt, 2, now);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int64(stmt, 3, id);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (exit != SQLITE_DONE)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+
+  this->isDownloaded = isDownloaded;
+  downloadedAt = now;
+}
+
+void Chapter::setRead(int page)
+{
+  Utils::ExecTime execTime("Chapter::setRead");
+  static constexpr const char *sql {"UPDATE chapter SET last_read_at = ?, last_read_page = ? WHERE id = ?"};
+  static constexpr const char *mangaSql {"UPDATE manga SET last_read_at = ? WHERE id = ?"};
+  sqlite3_stmt *stmt = nullptr;
+  const int64_t now {time(nullptr)};
+
+  Database::Tx t;
+  try {
+    int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    exit = sqlite3_bind_int64(stmt, 1, now);
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    exit = sqlite3_bind_int(stmt, 2, page);
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    exit = sqlite3_bind_int64(stmt, 3, id);
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    exit = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    stmt = nullptr;
+    if (exit != SQLITE_DONE)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+
+    exit = sqlite3_prepare_v2(Database::instance, mangaSql, -1, &stmt, nullptr);
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    exit = sqlite3_bind_int64(stmt, 1, now);
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    exit = sqlite3_bind_int64(stmt, 2, mangaId);
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    exit = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    stmt = nullptr;
+    if (exit != SQLITE_DONE)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  } catch (...) {
+    sqlite3_finalize(stmt);
+    t.rollback();
+    throw;
+  }
+
+  lastReadAt = now;
+  lastReadPage = page;
+}
+
+std::shared_ptr<Chapter> Chapter::find(int64_t id)
+{
+  static constexpr const char *sql {"SELECT * FROM chapter WHERE id = ?"};
+  sqlite3_stmt *stmt = nullptr;
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int64(stmt, 1, id);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_step(stmt);
+
+  std::shared_ptr<Chapter> chapter = nullptr;
+  if (exit == SQLITE_ROW)
+    chapter = std::make_shared<Chapter>(stmt);
+  sqlite3_finalize(stmt);
+  return chapter;
+}
+
 std::shared_ptr<Chapter> Chapter::find(std::string domain, std::string path)
 {
   static constexpr const char *sql {"SELECT * FROM chapter WHERE domain = ? AND path = ?"};
@@ -158,6 +294,52 @@ std::vector<std::shared_ptr<Chapter>> Chapter::findAll(int64_t mangaId)
   return chapters;
 }
 
+int64_t Chapter::lastChange()
+{
+  static constexpr const char *sql {"SELECT COALESCE(MAX(id), 0) FROM chapter_change"};
+  sqlite3_stmt *stmt = nullptr;
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_step(stmt);
+
+  int64_t id {};
+  if (exit == SQLITE_ROW)
+    id = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  if (exit != SQLITE_ROW)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  return id;
+}
+
+std::vector<std::shared_ptr<Chapter>> Chapter::findChanged(int64_t mangaId, int64_t since)
+{
+  static constexpr const char *sql {
+    "SELECT c.* FROM chapter_change x JOIN chapter c ON c.id = x.chapter_id"
+    " WHERE x.manga_id = ? AND x.id > ? ORDER BY x.id",
+  };
+  sqlite3_stmt *stmt = nullptr;
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int64(stmt, 1, mangaId);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int64(stmt, 2, since);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+
+  std::vector<std::shared_ptr<Chapter>> chapters {};
+  while (exit = sqlite3_step(stmt), exit == SQLITE_ROW)
+    chapters.push_back(std::make_shared<Chapter>(stmt));
+  sqlite3_finalize(stmt);
+  if (exit != SQLITE_DONE)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  return chapters;
+}
+
 void Chapter::saveAll(const std::vector<std::shared_ptr<Chapter>> &chapters, int64_t mangaId)
 {
   Utils::ExecTime execTime("Chapter::saveAll");
@@ -198,7 +380,19 @@ void Chapter::deserialize(sqlite3_stmt *stmt)
   const void *blob = sqlite3_column_blob(stmt, 12);
   if (blob != nullptr) {
     auto str = std::string(reinterpret_cast<const char *>(blob), sqlite3_column_bytes(stmt, 12));
-    pages = Database::deserializeArray(str);
+    // A JSON array, {"fetchedAt", "pages"} for a while or comma-separated
+    // before that
+    Json::Value root {};
+    Json::Reader reader {};
+    if (str.rfind('[', 0) != 0 && str.rfind('{', 0) != 0) {
+      pages = Database::deserializeArray(str);
+    } else if (reader.parse(str, root)) {
+      if (root.isObject())
+        root = root["pages"];
+      if (root.isArray())
+        for (const auto &page : root)
+          pages.push_back(page.asString());
+    }
   }
 
   pageCount = sqlite3_column_int(stmt, 13);
@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <core/models.h>
@@ -35,11 +36,23 @@ public:
   bool operator==(const Chapter &other) const;
   Json::Value toJson();
   void save(int64_t mangaId = 0);
-
+  // Stores pages and pageCount as fetched now, so the source is not asked
+  // again until they expire
+  void savePages();
+  void setDownloaded(bool isDownloaded);
+  // Records the page reached, on the chapter and its manga
+  void setRead(int page);
+
+  static std::shared_ptr<Chapter> find(int64_t id);
   static std::shared_ptr<Chapter> find(std::string domain, std::string path);
   static std::vector<std::shared_ptr<Chapter>> findAll(int64_t mangaId);
   static void saveAll(const std::vector<std::shared_ptr<Chapter>> &chapters, int64_t mangaId = 0);
 
+  // Position of the newest chapter change, a cursor for findChanged
+  static int64_t lastChange();
+  // Chapters of the manga added or changed after the change since
+  static std::vector<std::shared_ptr<Chapter>> findChanged(int64_t mangaId, int64_t since);
+
 private:
   void deserialize(sqlite3_stmt *stmt);
 };
@@ -0,0 +1,118 @@
+#include <stdexcept>
+
+#include <nonbiri/database.h>
+#include <nonbiri/models/download.h>
+#include <nonbiri/utility.h>
+
+Download::Download(sqlite3_stmt *stmt)
+{
+  deserialize(stmt);
+}
+
+Download::~Download() {}
+
+Json::Value Download::toJson()
+{
+  Json::Value root {};
+  root["chapterId"] = chapterId;
+  if (!domain.empty())
+    root["domain"] = domain;
+  if (addedAt > 0)
+    root["addedAt"] = addedAt;
+  if (attempts > 0)
+    root["attempts"] = attempts;
+  if (!error.empty())
+    root["error"] = error;
+  return root;
+}
+
+void Download::add(int64_t chapterId)
+{
+  Utils::ExecTime execTime("Download::add");
+  static constexpr const char *sql {"INSERT OR REPLACE INTO download_queue (chapter_id) VALUES (?)"};
+  sqlite3_stmt *stmt = nullptr;
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int64(stmt, 1, chapterId);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (exit != SQLITE_DONE)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+}
+
+void Download::remove(int64_t chapterId)
+{
+  Utils::ExecTime execTime("Download::remove");
+  static constexpr const char *sql {"DELETE FROM download_queue WHERE chapter_id = ?"};
+  sqlite3_stmt *stmt = nullptr;
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int64(stmt, 1, chapterId);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (exit != SQLITE_DONE)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+}
+
+void Download::fail(int64_t chapterId, const std::string &error)
+{
+  Utils::ExecTime execTime("Download::fail");
+  static constexpr const char *sql {"UPDATE download_queue SET attempts = attempts + 1, error = ? WHERE chapter_id = ?"};
+  sqlite3_stmt *stmt = nullptr;
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_text(stmt, 1, error.c_str(), -1, SQLITE_STATIC);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int64(stmt, 2, chapterId);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (exit != SQLITE_DONE)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+}
+
+std::vector<std::shared_ptr<Download>> Download::findAll()
+{
+  static constexpr const char *sql {
+    "SELECT q.chapter_id, c.domain, q.added_at, q.attempts, q.error"
+    " FROM download_queue q JOIN chapter c ON c.id = q.chapter_id"
+    " ORDER BY q.added_at",
+  };
+  sqlite3_stmt *stmt = nullptr;
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+
+  std::vector<std::shared_ptr<Download>> downloads {};
+  while (exit = sqlite3_step(stmt), exit == SQLITE_ROW)
+    downloads.push_back(std::make_shared<Download>(stmt));
+  sqlite3_finalize(stmt);
+  return downloads;
+}
+
+void Download::deserialize(sqlite3_stmt *stmt)
+{
+  if (stmt == nullptr)
+    throw std::invalid_argument("stmt cannot be null");
+
+  chapterId = sqlite3_column_int64(stmt, 0);
+  domain = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+  addedAt = sqlite3_column_int64(stmt, 2);
+  attempts = sqlite3_column_int64(stmt, 3);
+  const auto text = sqlite3_column_text(stmt, 4);
+  if (text != nullptr)
+    error = reinterpret_cast<const char *>(text);
+}
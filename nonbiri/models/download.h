@@ -0,0 +1,40 @@
+#ifndef NONBIRI_MODELS_DOWNLOAD_H_
+#define NONBIRI_MODELS_DOWNLOAD_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+#include <sqlite3.h>
+
+// A chapter waiting in the download queue. Rows stay until the chapter is
+// packed, so downloads cut short by a restart pick up where they left off.
+class Download
+{
+public:
+  int64_t chapterId {};
+  std::string domain {};
+  int64_t addedAt {};
+  int64_t attempts {};
+  std::string error {};
+
+public:
+  Download() = default;
+  Download(sqlite3_stmt *stmt);
+  ~Download();
+
+  Json::Value toJson();
+
+  // Queues the chapter again if it is already there, clearing its error
+  static void add(int64_t chapterId);
+  static void remove(int64_t chapterId);
+  static void fail(int64_t chapterId, const std::string &error);
+  // Oldest first
+  static std::vector<std::shared_ptr<Download>> findAll();
+
+private:
+  void deserialize(sqlite3_stmt *stmt);
+};
+
+#endif  // NONBIRI_MODELS_DOWNLOAD_H_
@@ -55,7 +55,8 @@ void Entity::save(const std::string &tableName)
 
 std::shared_ptr<Entity> Entity::find(const std::string &tableName, const std::string &name)
 {
-  const std::string sql {"SELECT * FROM " + tableName + " WHERE LOWER(name) = LOWER(?)"};
+  // Matches the NOCASE index, LOWER(name) would scan the whole table
+  const std::string sql {"SELECT * FROM " + tableName + " WHERE name = ? COLLATE NOCASE"};
   sqlite3_stmt *stmt = nullptr;
 
   int exit = sqlite3_prepare_v2(Database::instance, sql.c_str(), -1, &stmt, nullptr);
@@ -0,0 +1,181 @@
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+#include <nonbiri/covers.h>
+#include <nonbiri/database.h>
+#include <nonbiri/log.h>
+#include <nonbiri/models/history.h>
+#include <nonbiri/utility.h>
+
+History::History(sqlite3_stmt *stmt)
+{
+  deserialize(stmt);
+}
+
+History::~History() {}
+
+Json::Value History::toJson()
+{
+  Json::Value root {};
+  root["id"] = id;
+  root["readAt"] = readAt;
+  root["page"] = page;
+
+  Json::Value &chapter = root["chapter"];
+  chapter["domain"] = domain;
+  chapter["path"] = chapterPath;
+  chapter["name"] = chapterName;
+
+  Json::Value &manga = root["manga"];
+  manga["domain"] = domain;
+  manga["path"] = mangaPath;
+  manga["title"] = mangaTitle;
+  if (!coverUrl.empty()) {
+    manga["coverUrl"] = coverUrl;
+    for (const unsigned int width : Covers::widths)
+      manga["covers"][std::to_string(width)] = Covers::urlOf(domain, coverUrl, width);
+  }
+  return root;
+}
+
+void History::save()
+{
+  Utils::ExecTime execTime("History::save");
+  static constexpr const char *sql {
+    "INSERT INTO history ("
+    " domain, manga_path, manga_title, cover_url,"
+    " chapter_path, chapter_name, page"
+    ") VALUES (?, ?, ?, ?, ?, ?, ?)",
+  };
+  sqlite3_stmt *stmt = nullptr;
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_text(stmt, 1, domain.c_str(), -1, SQLITE_STATIC);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_text(stmt, 2, mangaPath.c_str(), -1, SQLITE_STATIC);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_text(stmt, 3, mangaTitle.c_str(), -1, SQLITE_STATIC);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_text(stmt, 4, coverUrl.c_str(), -1, SQLITE_STATIC);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_text(stmt, 5, chapterPath.c_str(), -1, SQLITE_STATIC);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_text(stmt, 6, chapterName.c_str(), -1, SQLITE_STATIC);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int(stmt, 7, page);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_step(stmt);
+
+  if (exit == SQLITE_DONE) {
+    id = sqlite3_last_insert_rowid(Database::instance);
+    readAt = time(nullptr);
+  }
+  sqlite3_finalize(stmt);
+  if (exit != SQLITE_DONE)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+}
+
+std::vector<std::shared_ptr<History>> History::findAll(int64_t before, int limit)
+{
+  // Walks the log backwards, each entry costs one probe of history_manga_idx
+  static constexpr const char *sql {
+    "SELECT h.id, h.domain, h.read_at, h.manga_path, h.manga_title, h.cover_url,"
+    " h.chapter_path, h.chapter_name, h.page"
+    " FROM history h WHERE h.id < ? AND NOT EXISTS ("
+    "  SELECT 1 FROM history n WHERE n.domain = h.domain AND n.manga_path = h.manga_path AND n.id > h.id"
+    " ) ORDER BY h.id DESC LIMIT ?",
+  };
+  sqlite3_stmt *stmt = nullptr;
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int64(stmt, 1, before > 0 ? before : INT64_MAX);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int(stmt, 2, limit);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+
+  std::vector<std::shared_ptr<History>> history {};
+  while (exit = sqlite3_step(stmt), exit == SQLITE_ROW)
+    history.push_back(std::make_shared<History>(stmt));
+  sqlite3_finalize(stmt);
+  if (exit != SQLITE_DONE)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  return history;
+}
+
+int History::compact(int tail)
+{
+  Utils::ExecTime execTime("History::compact");
+  static constexpr const char *sql {
+    "DELETE FROM history WHERE id <= (SELECT id FROM history ORDER BY id DESC LIMIT 1 OFFSET ?) AND EXISTS ("
+    " SELECT 1 FROM history n WHERE n.domain = history.domain AND n.manga_path = history.manga_path AND n.id > history.id"
+    ")",
+  };
+  sqlite3_stmt *stmt = nullptr;
+
+  Database::Tx t;
+  try {
+    int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    exit = sqlite3_bind_int(stmt, 1, tail);
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    exit = sqlite3_step(stmt);
+    const int changes = sqlite3_changes(Database::instance);
+    sqlite3_finalize(stmt);
+    if (exit != SQLITE_DONE)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    return changes;
+  } catch (...) {
+    t.rollback();
+    throw;
+  }
+}
+
+void History::initialize(int tail)
+{
+  // Reads only ever append to the history, this keeps it from growing
+  std::thread([tail]() {
+    while (true) {
+      std::this_thread::sleep_for(std::chrono::minutes(10));
+      try {
+        const int removed = compact(tail);
+        if (removed > 0)
+          LOG_DEBUG("Compacted " << removed << " history entries");
+      } catch (const std::exception &e) {
+        LOG_ERROR("Unable to compact history: " << e.what());
+      }
+    }
+  }).detach();
+}
+
+void History::deserialize(sqlite3_stmt *stmt)
+{
+  if (stmt == nullptr)
+    throw std::invalid_argument("stmt cannot be null");
+
+  id = sqlite3_column_int64(stmt, 0);
+  domain = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+  readAt = sqlite3_column_int64(stmt, 2);
+  mangaPath = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+  mangaTitle = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4));
+  coverUrl = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 5));
+  chapterPath = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 6));
+  chapterName = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 7));
+  page = sqlite3_column_int(stmt, 8);
+}
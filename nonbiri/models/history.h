@@ -0,0 +1,47 @@
+#ifndef NONBIRI_MODELS_HISTORY_H_
+#define NONBIRI_MODELS_HISTORY_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+#include <sqlite3.h>
+
+// An entry of the reading history log. Reads are only ever appended, the
+// compactor is what drops the entries nobody will look at again.
+class History
+{
+public:
+  int64_t id {};
+  std::string domain {};
+  int64_t readAt {};
+  std::string mangaPath {};
+  std::string mangaTitle {};
+  std::string coverUrl {};
+  std::string chapterPath {};
+  std::string chapterName {};
+  int page {};
+
+public:
+  History() = default;
+  History(sqlite3_stmt *stmt);
+  ~History();
+
+  Json::Value toJson();
+  void save();
+
+  // The newest entry of each title, newest first, older than the entry
+  // with id before when it is set
+  static std::vector<std::shared_ptr<History>> findAll(int64_t before, int limit);
+  // Drops entries that are neither among the newest tail ones nor the
+  // newest of their title, returns how many went
+  static int compact(int tail);
+  // Compacts the log every ten minutes on a thread of its own
+  static void initialize(int tail);
+
+private:
+  void deserialize(sqlite3_stmt *stmt);
+};
+
+#endif  // NONBIRI_MODELS_HISTORY_H_
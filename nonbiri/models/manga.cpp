@@ -2,6 +2,7 @@
 #include <stdexcept>
 
 #include <nonbiri/cache.h>
+#include <nonbiri/covers.h>
 #include <nonbiri/database.h>
 #include <nonbiri/models/chapter.h>
 #include <nonbiri/models/entity.h>
@@ -42,8 +43,11 @@ Json::Value Manga::toJson()
     root["lastViewedAt"] = lastViewedAt;
   if (!path.empty())
     root["path"] = path;
-  if (!coverUrl.empty())
+  if (!coverUrl.empty()) {
     root["coverUrl"] = coverUrl;
+    for (const unsigned int width : Covers::widths)
+      root["covers"][std::to_string(width)] = Covers::urlOf(domain, coverUrl, width);
+  }
   if (!customCoverUrl.empty())
     root["customCoverUrl"] = customCoverUrl;
   if (!bannerUrl.empty())
@@ -280,6 +284,30 @@ std::shared_ptr<Manga> Manga::find(const std::string &domain, const std::string
   return manga;
 }
 
+std::vector<std::shared_ptr<Manga>> Manga::findAllFollowed()
+{
+  static constexpr const char *sql {"SELECT * FROM manga WHERE reading_status IN (?, ?, ?) ORDER BY domain, id"};
+  sqlite3_stmt *stmt = nullptr;
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  int index {1};
+  for (const auto status : {ReadingStatus::Reading, ReadingStatus::Planned, ReadingStatus::OnHold}) {
+    exit = sqlite3_bind_int(stmt, index++, static_cast<int>(status));
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  }
+
+  std::vector<std::shared_ptr<Manga>> manga {};
+  while (exit = sqlite3_step(stmt), exit == SQLITE_ROW)
+    manga.push_back(std::make_shared<Manga>(stmt));
+  sqlite3_finalize(stmt);
+  if (exit != SQLITE_DONE)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  return manga;
+}
+
 int64_t Manga::setReadState(ReadingStatus status, const std::string &domain, const std::string &path)
 {
   Utils::ExecTime execTime("Manga::setReadState(status, domain, path, manga)");
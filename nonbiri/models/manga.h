@@ -52,6 +52,9 @@ public:
   void remove();
 
   static std::shared_ptr<Manga> find(const std::string &domain, const std::string &path);
+  // Titles being read, planned or on hold, without their artists, authors
+  // and genres
+  static std::vector<std::shared_ptr<Manga>> findAllFollowed();
   static bool exists(const std::string &domain, const std::string &path);
   static ReadingStatus getReadState(const std::string &domain, const std::string &path);
   static int64_t setReadState(ReadingStatus status, const std::string &domain, const std::string &path);
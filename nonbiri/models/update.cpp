@@ -0,0 +1,175 @@
+#include <cstdint>
+#include <stdexcept>
+
+#include <nonbiri/covers.h>
+#include <nonbiri/database.h>
+#include <nonbiri/models/chapter.h>
+#include <nonbiri/models/manga.h>
+#include <nonbiri/models/update.h>
+#include <nonbiri/utility.h>
+
+Update::Update(sqlite3_stmt *stmt)
+{
+  deserialize(stmt);
+}
+
+Update::~Update() {}
+
+Json::Value Update::toJson()
+{
+  Json::Value root {};
+  root["id"] = id;
+  root["addedAt"] = addedAt;
+
+  Json::Value &chapter = root["chapter"];
+  chapter["id"] = chapterId;
+  chapter["domain"] = domain;
+  chapter["path"] = chapterPath;
+  chapter["name"] = chapterName;
+  if (publishedAt > 0)
+    chapter["publishedAt"] = publishedAt;
+
+  Json::Value &manga = root["manga"];
+  manga["id"] = mangaId;
+  manga["domain"] = domain;
+  manga["path"] = mangaPath;
+  manga["title"] = mangaTitle;
+  if (!coverUrl.empty()) {
+    manga["coverUrl"] = coverUrl;
+    for (const unsigned int width : Covers::widths)
+      manga["covers"][std::to_string(width)] = Covers::urlOf(domain, coverUrl, width);
+  }
+  return root;
+}
+
+void Update::addAll(const Manga &manga, const std::vector<std::shared_ptr<Chapter>> &chapters)
+{
+  Utils::ExecTime execTime("Update::addAll");
+  static constexpr const char *sql {
+    "INSERT OR IGNORE INTO updates_feed ("
+    " manga_id, chapter_id, domain, published_at,"
+    " manga_path, manga_title, cover_url, chapter_path, chapter_name"
+    ") VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
+  };
+  // Everything past the newest maxEntries
+  static constexpr const char *trimSql {
+    "DELETE FROM updates_feed WHERE id <= (SELECT id FROM updates_feed ORDER BY id DESC LIMIT 1 OFFSET ?)",
+  };
+  if (chapters.empty())
+    return;
+
+  sqlite3_stmt *stmt = nullptr;
+  Database::Tx t;
+  try {
+    for (const auto &chapter : chapters) {
+      if (chapter->id <= 0)
+        chapter->save(manga.id);
+    }
+
+    int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+
+    // Oldest first, so the newest chapter gets the highest id
+    for (auto it = chapters.rbegin(); it != chapters.rend(); it++) {
+      const Chapter &chapter = **it;
+      if (chapter.id <= 0)
+        continue;
+      sqlite3_reset(stmt);
+      exit = sqlite3_bind_int64(stmt, 1, manga.id);
+      if (exit != SQLITE_OK)
+        throw std::runtime_error(sqlite3_errmsg(Database::instance));
+      exit = sqlite3_bind_int64(stmt, 2, chapter.id);
+      if (exit != SQLITE_OK)
+        throw std::runtime_error(sqlite3_errmsg(Database::instance));
+      exit = sqlite3_bind_text(stmt, 3, manga.domain.c_str(), -1, SQLITE_STATIC);
+      if (exit != SQLITE_OK)
+        throw std::runtime_error(sqlite3_errmsg(Database::instance));
+      exit = sqlite3_bind_int64(stmt, 4, chapter.publishedAt);
+      if (exit != SQLITE_OK)
+        throw std::runtime_error(sqlite3_errmsg(Database::instance));
+      exit = sqlite3_bind_text(stmt, 5, manga.path.c_str(), -1, SQLITE_STATIC);
+      if (exit != SQLITE_OK)
+        throw std::runtime_error(sqlite3_errmsg(Database::instance));
+      exit = sqlite3_bind_text(stmt, 6, manga.title.c_str(), -1, SQLITE_STATIC);
+      if (exit != SQLITE_OK)
+        throw std::runtime_error(sqlite3_errmsg(Database::instance));
+      const auto &coverUrl = manga.customCoverUrl.empty() ? manga.coverUrl : manga.customCoverUrl;
+      exit = sqlite3_bind_text(stmt, 7, coverUrl.c_str(), -1, SQLITE_STATIC);
+      if (exit != SQLITE_OK)
+        throw std::runtime_error(sqlite3_errmsg(Database::instance));
+      exit = sqlite3_bind_text(stmt, 8, chapter.path.c_str(), -1, SQLITE_STATIC);
+      if (exit != SQLITE_OK)
+        throw std::runtime_error(sqlite3_errmsg(Database::instance));
+      exit = sqlite3_bind_text(stmt, 9, chapter.name.c_str(), -1, SQLITE_STATIC);
+      if (exit != SQLITE_OK)
+        throw std::runtime_error(sqlite3_errmsg(Database::instance));
+      exit = sqlite3_step(stmt);
+      if (exit != SQLITE_DONE)
+        throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    }
+    sqlite3_finalize(stmt);
+    stmt = nullptr;
+
+    exit = sqlite3_prepare_v2(Database::instance, trimSql, -1, &stmt, nullptr);
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    exit = sqlite3_bind_int(stmt, 1, maxEntries);
+    if (exit != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+    exit = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (exit != SQLITE_DONE)
+      throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  } catch (...) {
+    sqlite3_finalize(stmt);
+    t.rollback();
+    throw;
+  }
+}
+
+std::vector<std::shared_ptr<Update>> Update::findAll(int64_t before, int limit)
+{
+  static constexpr const char *sql {
+    "SELECT id, manga_id, chapter_id, domain, added_at, published_at,"
+    " manga_path, manga_title, cover_url, chapter_path, chapter_name"
+    " FROM updates_feed WHERE id < ? ORDER BY id DESC LIMIT ?",
+  };
+  sqlite3_stmt *stmt = nullptr;
+
+  int exit = sqlite3_prepare_v2(Database::instance, sql, -1, &stmt, nullptr);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int64(stmt, 1, before > 0 ? before : INT64_MAX);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  exit = sqlite3_bind_int(stmt, 2, limit);
+  if (exit != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+
+  std::vector<std::shared_ptr<Update>> updates {};
+  while (exit = sqlite3_step(stmt), exit == SQLITE_ROW)
+    updates.push_back(std::make_shared<Update>(stmt));
+  sqlite3_finalize(stmt);
+  if (exit != SQLITE_DONE)
+    throw std::runtime_error(sqlite3_errmsg(Database::instance));
+  return updates;
+}
+
+void Update::deserialize(sqlite3_stmt *stmt)
+{
+  if (stmt == nullptr)
+    throw std::invalid_argument("stmt cannot be null");
+
+  id = sqlite3_column_int64(stmt, 0);
+  mangaId = sqlite3_column_int64(stmt, 1);
+  chapterId = sqlite3_column_int64(stmt, 2);
+  domain = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+  addedAt = sqlite3_column_int64(stmt, 4);
+  publishedAt = sqlite3_column_int64(stmt, 5);
+  mangaPath = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 6));
+  mangaTitle = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 7));
+  coverUrl = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 8));
+  chapterPath = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 9));
+  chapterName = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 10));
+}
@@ -0,0 +1,51 @@
+#ifndef NONBIRI_MODELS_UPDATE_H_
+#define NONBIRI_MODELS_UPDATE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+#include <sqlite3.h>
+
+class Chapter;
+class Manga;
+
+// An entry of the updates feed: a chapter that turned up for a library
+// title after it was added. The feed keeps the newest maxEntries of them.
+class Update
+{
+public:
+  static constexpr int maxEntries {2000};
+
+  int64_t id {};
+  int64_t mangaId {};
+  int64_t chapterId {};
+  std::string domain {};
+  int64_t addedAt {};
+  int64_t publishedAt {};
+  std::string mangaPath {};
+  std::string mangaTitle {};
+  std::string coverUrl {};
+  std::string chapterPath {};
+  std::string chapterName {};
+
+public:
+  Update() = default;
+  Update(sqlite3_stmt *stmt);
+  ~Update();
+
+  Json::Value toJson();
+
+  // Chapters are taken in source order, newest first. Those not stored yet
+  // are saved to manga in the same transaction, so a chapter is never in
+  // the library without its feed entry.
+  static void addAll(const Manga &manga, const std::vector<std::shared_ptr<Chapter>> &chapters);
+  // Newest first, entries older than the one with id before when it is set
+  static std::vector<std::shared_ptr<Update>> findAll(int64_t before, int limit);
+
+private:
+  void deserialize(sqlite3_stmt *stmt);
+};
+
+#endif  // NONBIRI_MODELS_UPDATE_H_
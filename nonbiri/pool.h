@@ -0,0 +1,103 @@
+#ifndef NONBIRI_POOL_H_
+#define NONBIRI_POOL_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Jobs against many sources, worked through by a fixed set of threads and
+// never more than perSource at once against one source. Workers take the
+// first queued job whose source is below its limit, so a busy source only
+// holds up its own jobs. Job needs a domain member naming its source.
+template<class Job>
+class SourcePool
+{
+public:
+  struct Handlers
+  {
+    // Runs the job on a worker, anything it throws is the handler's to catch
+    std::function<void(Job &job)> run {};
+    // Runs with mutex held as the job leaves the queue
+    std::function<void(Job &job)> onTake {};
+    // Runs on each worker before its first job
+    std::function<void()> onStart {};
+  };
+
+  // Guards queue, and whatever state of the owner goes along with it
+  std::mutex mutex {};
+  // Changed with mutex held, notify() afterwards wakes the workers
+  std::deque<Job> queue {};
+
+  void start(unsigned int threads, unsigned int perSource, Handlers handlers);
+  void notify();
+
+private:
+  unsigned int mPerSource {1};
+  Handlers mHandlers {};
+  std::condition_variable cv {};
+  // Jobs running per domain
+  std::map<std::string, unsigned int> running {};
+
+  void work();
+};
+
+template<class Job>
+void SourcePool<Job>::start(unsigned int threads, unsigned int perSource, Handlers handlers)
+{
+  mPerSource = std::max(1U, perSource);
+  mHandlers = std::move(handlers);
+  for (unsigned int i = 0; i < threads; i++)
+    std::thread([this] { work(); }).detach();
+}
+
+template<class Job>
+void SourcePool<Job>::notify()
+{
+  cv.notify_all();
+}
+
+template<class Job>
+void SourcePool<Job>::work()
+{
+  if (mHandlers.onStart)
+    mHandlers.onStart();
+
+  const auto isAllowed = [this](const Job &job) {
+    const auto it = running.find(job.domain);
+    return it == running.end() || it->second < mPerSource;
+  };
+
+  while (true) {
+    Job job {};
+    {
+      std::unique_lock lock(mutex);
+      typename std::deque<Job>::iterator it {};
+      cv.wait(lock, [&] {
+        it = std::find_if(queue.begin(), queue.end(), isAllowed);
+        return it != queue.end();
+      });
+      job = std::move(*it);
+      queue.erase(it);
+      running[job.domain]++;
+      if (mHandlers.onTake)
+        mHandlers.onTake(job);
+    }
+
+    mHandlers.run(job);
+
+    {
+      std::lock_guard lock(mutex);
+      if (--running[job.domain] == 0)
+        running.erase(job.domain);
+    }
+    // Jobs of the same source may have been waiting on this one
+    cv.notify_all();
+  }
+}
+
+#endif  // NONBIRI_POOL_H_
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+#  define WIN32_LEAN_AND_MEAN
+#  include <Windows.h>
+#elif defined(__linux__)
+#  include <sys/resource.h>
+#endif
+
+#include <nonbiri/images.h>
+#include <nonbiri/log.h>
+#include <nonbiri/manager.h>
+#include <nonbiri/metrics.h>
+#include <nonbiri/pool.h>
+#include <nonbiri/prefetch.h>
+
+struct Job
+{
+  std::string domain {};
+  std::string path {};
+  std::string mangaPath {};
+};
+
+// Readers that move on quickly leave old jobs behind, those are dropped first
+static constexpr size_t maxQueued {64};
+
+static Prefetch::Options options {};
+static SourcePool<Job> pool {};
+
+static Metrics::Counter &jobs(const std::string &result)
+{
+  return Metrics::counter("nonbiri_prefetch_jobs_total", {{"result", result}});
+}
+
+static void lowerPriority()
+{
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+  // Linux gives every thread its own nice value, this only lowers the caller
+  setpriority(PRIO_PROCESS, 0, 10);
+#endif
+}
+
+// Chapters in reading order after path, at most options.chapters of them
+static std::vector<std::string> nextChapters(Extension &ext, const Job &job)
+{
+  std::vector<std::shared_ptr<Chapter>> chapters {};
+  const auto chapter = Chapter::find(ext.domain, job.path);
+  if (chapter != nullptr)
+    chapters = Chapter::findAll(chapter->mangaId);
+  else if (!job.mangaPath.empty())
+    chapters = App::manager->getChapters(ext, job.mangaPath);
+
+  // Sources list the newest chapter first, ties keep that order reversed
+  std::reverse(chapters.begin(), chapters.end());
+  std::stable_sort(chapters.begin(), chapters.end(), [](const auto &a, const auto &b) { return a->publishedAt < b->publishedAt; });
+
+  const auto it = std::find_if(chapters.begin(), chapters.end(), [&](const auto &c) { return c->path == job.path; });
+  if (it == chapters.end())
+    return {};
+
+  std::vector<std::string> paths {};
+  for (auto next = it + 1; next != chapters.end() && paths.size() < options.chapters; next++)
+    paths.push_back((*next)->path);
+  return paths;
+}
+
+static void prefetch(const Job &job)
+{
+  const auto ext = App::manager->getExtension(job.domain);
+  if (ext == nullptr)
+    return;
+
+  for (const auto &path : nextChapters(*ext, job)) {
+    // Stored or cached by getPages, so opening the chapter costs nothing
+    const auto pages = App::manager->getPages(*ext, path);
+    for (size_t i = 0; i < pages.size() && i < options.images; i++) {
+      try {
+        Images::fetch(pages[i], ext->baseUrl.empty() ? "" : ext->baseUrl + "/");
+      } catch (const std::exception &e) {
+        LOG_ERROR("Unable to prefetch " << pages[i] << ": " << e.what());
+      }
+    }
+  }
+}
+
+static void run(Job &job)
+{
+  try {
+    prefetch(job);
+    jobs("done").increment();
+  } catch (const std::exception &e) {
+    jobs("failed").increment();
+    LOG_ERROR("Unable to prefetch chapters after " << job.path << ": " << e.what());
+  }
+}
+
+void Prefetch::initialize(const Options &opts)
+{
+  options = opts;
+  pool.start(options.threads, options.perSource, {run, {}, lowerPriority});
+}
+
+void Prefetch::schedule(const std::string &domain, const std::string &path, const std::string &mangaPath)
+{
+  if (options.threads == 0 || options.chapters == 0)
+    return;
+
+  {
+    std::lock_guard lock(pool.mutex);
+    auto &queue = pool.queue;
+    const auto queued = std::find_if(queue.begin(), queue.end(), [&](const Job &job) { return job.domain == domain && job.path == path; });
+    if (queued != queue.end())
+      return;
+    if (queue.size() >= maxQueued) {
+      queue.pop_front();
+      jobs("dropped").increment();
+    }
+    queue.push_back({domain, path, mangaPath});
+  }
+  pool.notify();
+}
@@ -0,0 +1,29 @@
+#ifndef NONBIRI_PREFETCH_H_
+#define NONBIRI_PREFETCH_H_
+
+#include <string>
+
+// Resolves the page lists of the chapters after the one being read, so
+// moving on to the next chapter does not wait on the source. Runs on its
+// own low priority threads and never more than a few requests per source.
+namespace Prefetch
+{
+struct Options
+{
+  // 0 disables prefetching
+  unsigned int threads {};
+  // Chapters after the opened one to resolve
+  unsigned int chapters {};
+  // Prefetches allowed to run against one source at once
+  unsigned int perSource {};
+  // Leading images of each chapter to store for /api/image
+  unsigned int images {};
+};
+
+void initialize(const Options &options);
+// Queues the chapters after path and returns right away. mangaPath finds
+// them for chapters outside the library.
+void schedule(const std::string &domain, const std::string &path, const std::string &mangaPath = "");
+}  // namespace Prefetch
+
+#endif  // NONBIRI_PREFETCH_H_
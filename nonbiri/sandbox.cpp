@@ -0,0 +1,654 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <core/core.h>
+#include <core/filters.h>
+#include <core/prefs.h>
+#include <nonbiri/http/client.h>
+#include <nonbiri/http/fixture.h>
+#include <nonbiri/log.h>
+#include <nonbiri/manager.h>
+#include <nonbiri/metrics.h>
+#include <nonbiri/sandbox.h>
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__)
+#  include <cerrno>
+#  include <csignal>
+#  include <cstring>
+
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <sys/mman.h>
+#  include <sys/resource.h>
+#  include <sys/socket.h>
+#  include <sys/syscall.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
+namespace Sandbox
+{
+static Json::Value toJson(const Manga_t &manga)
+{
+  Json::Value root {};
+  root["path"] = manga.path;
+  root["coverUrl"] = manga.coverUrl;
+  root["title"] = manga.title;
+  root["description"] = manga.description;
+  root["status"] = static_cast<int>(manga.status);
+  for (const auto &artist : manga.artists)
+    root["artists"].append(artist);
+  for (const auto &author : manga.authors)
+    root["authors"].append(author);
+  for (const auto &genre : manga.genres)
+    root["genres"].append(genre);
+  return root;
+}
+
+static Json::Value toJson(const Chapter_t &chapter)
+{
+  Json::Value root {};
+  root["publishedAt"] = static_cast<Json::Int64>(chapter.publishedAt);
+  root["path"] = chapter.path;
+  root["name"] = chapter.name;
+  for (const auto &group : chapter.groups)
+    root["groups"].append(group);
+  return root;
+}
+
+static std::vector<std::string> toStrings(const Json::Value &json)
+{
+  std::vector<std::string> result {};
+  for (const auto &value : json)
+    result.push_back(value.asString());
+  return result;
+}
+
+static std::shared_ptr<Manga_t> toManga(const Json::Value &json)
+{
+  auto manga = std::make_shared<Manga_t>();
+  manga->path = json["path"].asString();
+  manga->coverUrl = json["coverUrl"].asString();
+  manga->title = json["title"].asString();
+  manga->description = json["description"].asString();
+  manga->status = static_cast<MangaStatus>(json["status"].asInt());
+  manga->artists = toStrings(json["artists"]);
+  manga->authors = toStrings(json["authors"]);
+  manga->genres = toStrings(json["genres"]);
+  return manga;
+}
+
+static std::shared_ptr<Chapter_t> toChapter(const Json::Value &json)
+{
+  auto chapter = std::make_shared<Chapter_t>();
+  chapter->publishedAt = json["publishedAt"].asInt64();
+  chapter->path = json["path"].asString();
+  chapter->name = json["name"].asString();
+  chapter->groups = toStrings(json["groups"]);
+  return chapter;
+}
+
+// Runs inside the worker, the result is sent back as is.
+static Json::Value dispatch(Extension &ext, const Json::Value &request)
+{
+  const auto method = request["method"].asString();
+  Json::Value result {};
+
+  if (method == "info") {
+    result["domain"] = ext.domain;
+    result["name"] = ext.name;
+    result["description"] = ext.description;
+    result["language"] = ext.language;
+    result["version"] = ext.version;
+    result["isNsfw"] = ext.isNsfw;
+
+    const auto filters = dynamic_cast<const Filters *>(&ext);
+    result["hasFilters"] = filters != nullptr;
+    if (filters != nullptr) {
+      result["filters"] = Json::arrayValue;
+      for (const auto &filter : filters->list()) {
+        if (dynamic_cast<const Filter::Hidden *>(filter.get()) == nullptr)
+          result["filters"].append(filter->toJson());
+      }
+      result["filterKeys"] = Json::arrayValue;
+      for (const auto &[key, _] : filters->index())
+        result["filterKeys"].append(key);
+    }
+    result["hasPrefs"] = dynamic_cast<const Prefs *>(&ext) != nullptr;
+  } else if (method == "getLatests" || method == "searchManga") {
+    const int page = request["page"].asInt();
+    std::vector<std::pair<std::string, std::string>> filters {};
+    for (const auto &filter : request["filters"])
+      filters.emplace_back(filter[0].asString(), filter[1].asString());
+
+    const auto [entries, hasNext] = method == "getLatests"
+      ? ext.getLatests(page)
+      : ext.searchManga(page, request["query"].asString(), filters);
+
+    result["entries"] = Json::arrayValue;
+    for (const auto &entry : entries)
+      result["entries"].append(toJson(*entry));
+    result["hasNext"] = hasNext;
+  } else if (method == "getManga") {
+    const auto manga = ext.getManga(request["path"].asString());
+    if (manga != nullptr)
+      result = toJson(*manga);
+  } else if (method == "getChapters") {
+    result = Json::arrayValue;
+    for (const auto &chapter : ext.getChapters(request["path"].asString()))
+      result.append(toJson(*chapter));
+  } else if (method == "getPages") {
+    result = Json::arrayValue;
+    for (const auto &page : ext.getPages(request["path"].asString()))
+      result.append(page);
+  } else if (method == "getPrefs" || method == "setPrefs") {
+    auto prefs = dynamic_cast<Prefs *>(&ext);
+    if (prefs == nullptr)
+      throw std::runtime_error("Extension does not support preferences");
+    if (method == "setPrefs")
+      prefs->update(request["prefs"]);
+    result = prefs->toJson();
+  } else {
+    throw std::runtime_error("Unknown method: " + method);
+  }
+  return result;
+}
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+class Worker
+{
+};
+
+IsolatedExtension::IsolatedExtension(const std::string &path, const Options &options) : mOptions {options}
+{
+  throw std::runtime_error("Isolated extensions are not supported on this platform");
+}
+
+IsolatedExtension::~IsolatedExtension() {}
+
+Json::Value IsolatedExtension::call(const Json::Value &request)
+{
+  throw std::runtime_error("Isolated extensions are not supported on this platform");
+}
+
+int serve()
+{
+  LOG_ERROR("Isolated extensions are not supported on this platform");
+  return 1;
+}
+#else
+// The worker's end of the socket and the library it hosts.
+static constexpr int socketFd {3};
+static constexpr int libraryFd {4};
+
+// Larger payloads are written to a memfd whose descriptor is passed along
+// instead, a datagram this size fits the default socket buffer.
+static constexpr size_t inlineLimit {64 * 1024};
+
+struct Header
+{
+  uint64_t size {};
+};
+
+static bool writeAll(int fd, const char *data, size_t size)
+{
+  while (size > 0) {
+    const ssize_t n = write(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool sendMessage(int fd, const Json::Value &value)
+{
+  const std::string payload {Json::FastWriter().write(value)};
+  Header header {payload.size()};
+
+  iovec iov[2] {
+    {&header, sizeof(header)},
+    {const_cast<char *>(payload.data()), payload.size()},
+  };
+  msghdr msg {};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+
+  int memfd {-1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] {};
+  if (payload.size() > inlineLimit) {
+    memfd = memfd_create("nonbiri-ipc", MFD_CLOEXEC);
+    if (memfd < 0)
+      return false;
+    if (!writeAll(memfd, payload.data(), payload.size())) {
+      close(memfd);
+      return false;
+    }
+
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+  }
+
+  ssize_t n {};
+  do {
+    n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+
+  if (memfd >= 0)
+    close(memfd);
+  return n >= 0;
+}
+
+static bool receiveMessage(int fd, Json::Value &value)
+{
+  thread_local std::vector<char> buffer(sizeof(Header) + inlineLimit);
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] {};
+
+  iovec iov {buffer.data(), buffer.size()};
+  msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t n {};
+  do {
+    n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+
+  if (n < static_cast<ssize_t>(sizeof(Header)))
+    return false;
+
+  Header header {};
+  memcpy(&header, buffer.data(), sizeof(header));
+
+  int memfd {-1};
+  const auto cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    memcpy(&memfd, CMSG_DATA(cmsg), sizeof(int));
+
+  Json::Reader reader {};
+  if (memfd < 0) {
+    const char *begin = buffer.data() + sizeof(header);
+    return static_cast<size_t>(n) == sizeof(header) + header.size && reader.parse(begin, begin + header.size, value, false);
+  }
+
+  // Parsed straight from the mapping, the payload is never copied.
+  void *data = mmap(nullptr, header.size, PROT_READ, MAP_PRIVATE, memfd, 0);
+  close(memfd);
+  if (data == MAP_FAILED)
+    return false;
+
+  const char *begin = static_cast<const char *>(data);
+  const bool ok = reader.parse(begin, begin + header.size, value, false);
+  munmap(data, header.size);
+  return ok;
+}
+
+class Worker
+{
+  pid_t pid {-1};
+  int fd {-1};
+
+public:
+  // prefsVersion of the extension this process is at
+  size_t appliedPrefs {};
+
+  ~Worker()
+  {
+    stop();
+  }
+
+  bool isRunning() const
+  {
+    return pid > 0;
+  }
+
+  void start(int library, const Options &options)
+  {
+    int fds[2] {};
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) != 0)
+      throw std::runtime_error("Unable to create worker socket");
+
+    // Prepared up front, the child only makes async-signal-safe calls
+    // between fork and exec.
+    const rlimit cpu {options.cpuSeconds, options.cpuSeconds + 1ULL};
+    const rlimit memory {options.memory * 1024ULL * 1024ULL, options.memory * 1024ULL * 1024ULL};
+    const long maxFd {sysconf(_SC_OPEN_MAX)};
+    char name[] {"nonbiri"};
+    char flag[] {"--worker"};
+    char *const argv[] {name, flag, nullptr};
+
+    pid = fork();
+    if (pid < 0) {
+      close(fds[0]);
+      close(fds[1]);
+      throw std::runtime_error("Unable to start worker");
+    }
+
+    // No PR_SET_PDEATHSIG, it fires when the forking thread exits. The
+    // worker leaves on its own once the socket is closed instead.
+    if (pid == 0) {
+      // Moved out of the way first in case either already sits on 3 or 4.
+      const int socket = fcntl(fds[1], F_DUPFD, 16);
+      const int lib = fcntl(library, F_DUPFD, 16);
+      if (socket < 0 || lib < 0 || dup2(socket, socketFd) < 0 || dup2(lib, libraryFd) < 0)
+        _exit(127);
+
+#  ifdef SYS_close_range
+      if (syscall(SYS_close_range, libraryFd + 1, ~0U, 0) != 0)
+#  endif
+        for (long i = libraryFd + 1; i < maxFd; i++)
+          close(i);
+
+      if (options.cpuSeconds > 0)
+        setrlimit(RLIMIT_CPU, &cpu);
+      if (options.memory > 0)
+        setrlimit(RLIMIT_AS, &memory);
+
+      execv("/proc/self/exe", argv);
+      _exit(127);
+    }
+
+    close(fds[1]);
+    fd = fds[0];
+    appliedPrefs = 0;
+  }
+
+  // Kills the worker if it is still around and reports how it ended.
+  std::string stop()
+  {
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+    if (pid <= 0)
+      return {};
+
+    kill(pid, SIGKILL);
+    int status {};
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    pid = -1;
+
+    if (WIFEXITED(status))
+      return "exited with code " + std::to_string(WEXITSTATUS(status));
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGXCPU)
+      return "exceeded its CPU limit";
+    if (WIFSIGNALED(status))
+      return "was killed by signal " + std::to_string(WTERMSIG(status));
+    return "exited";
+  }
+
+  Json::Value call(const Json::Value &request, unsigned int timeout)
+  {
+    if (!sendMessage(fd, request))
+      throw std::runtime_error("Worker " + stop());
+
+    pollfd pfd {fd, POLLIN, 0};
+    int n {};
+    do {
+      n = poll(&pfd, 1, timeout > 0 ? static_cast<int>(timeout * 1000) : -1);
+    } while (n < 0 && errno == EINTR);
+
+    if (n == 0) {
+      stop();
+      throw std::runtime_error("Worker timed out");
+    }
+
+    Json::Value response {};
+    if (!receiveMessage(fd, response))
+      throw std::runtime_error("Worker " + stop());
+    return response;
+  }
+};
+
+IsolatedExtension::IsolatedExtension(const std::string &path, const Options &options) : mOptions {options}
+{
+  libraryFd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (libraryFd < 0)
+    throw std::runtime_error("Unable to open extension");
+
+  for (unsigned int i = 0; i < std::max(1U, options.workers); i++) {
+    workers.push_back(std::make_unique<Worker>());
+    idle.push_back(workers.back().get());
+  }
+
+  Json::Value request {};
+  request["method"] = "info";
+
+  Json::Value info {};
+  try {
+    info = call(request);
+  } catch (...) {
+    close(libraryFd);
+    throw;
+  }
+
+  domain = info["domain"].asString();
+  name = info["name"].asString();
+  description = info["description"].asString();
+  language = info["language"].asString();
+  version = info["version"].asString();
+  isNsfw = info["isNsfw"].asBool();
+  hasFilters = info["hasFilters"].asBool();
+  filters = info["filters"];
+  for (const auto &key : info["filterKeys"])
+    filterKeys.insert(key.asString());
+  hasPrefs = info["hasPrefs"].asBool();
+}
+
+IsolatedExtension::~IsolatedExtension()
+{
+  workers.clear();
+  close(libraryFd);
+}
+
+Json::Value IsolatedExtension::call(const Json::Value &request)
+{
+  Worker *worker {};
+  {
+    std::unique_lock lock(mutex);
+    cv.wait(lock, [this] { return !idle.empty(); });
+    worker = idle.back();
+    idle.pop_back();
+  }
+
+  const auto release = [&] {
+    {
+      std::lock_guard lock(mutex);
+      idle.push_back(worker);
+    }
+    cv.notify_one();
+  };
+
+  Json::Value response {};
+  try {
+    if (!worker->isRunning())
+      worker->start(libraryFd, mOptions);
+
+    // A new worker or one that missed changes made through another
+    Json::Value change {};
+    size_t version {};
+    {
+      std::lock_guard lock(prefsMutex);
+      version = prefsVersion;
+      if (worker->appliedPrefs < version) {
+        change["method"] = "setPrefs";
+        change["prefs"] = prefsChanges;
+      }
+    }
+    if (!change.isNull()) {
+      if (const auto result = worker->call(change, mOptions.timeout); result.isMember("error"))
+        LOG_WARN("Unable to apply prefs of " << domain << ": " << result["error"].asString());
+      worker->appliedPrefs = version;
+    }
+
+    response = worker->call(request, mOptions.timeout);
+    if (request["method"] == "setPrefs" && !response.isMember("error")) {
+      std::lock_guard lock(prefsMutex);
+      const auto &prefs = request["prefs"];
+      if (prefs.isObject() && (prefsChanges.isObject() || prefsChanges.isNull())) {
+        for (const auto &key : prefs.getMemberNames())
+          prefsChanges[key] = prefs[key];
+      } else {
+        prefsChanges = prefs;
+      }
+      worker->appliedPrefs = ++prefsVersion;
+    }
+  } catch (const std::exception &e) {
+    release();
+    Metrics::counter("nonbiri_extension_worker_failures_total", {{"domain", domain}}).increment();
+    LOG_WARN("Extension worker for " << (domain.empty() ? "new extension" : domain) << ": " << e.what());
+    throw;
+  }
+  release();
+
+  if (response.isMember("error"))
+    throw std::runtime_error(response["error"].asString());
+  return response["result"];
+}
+
+int serve()
+{
+  HttpClient::initialize();
+  HttpFixture::inherit();
+
+  auto handle = Utils::loadLibrary("/proc/self/fd/" + std::to_string(libraryFd));
+  if (handle == nullptr) {
+    LOG_ERROR("Unable to load extension");
+    return 1;
+  }
+
+  Extension *ext {};
+  try {
+    ext = createExtension(handle);
+  } catch (const std::exception &e) {
+    LOG_ERROR("Unable to create extension: " << e.what());
+    Utils::freeLibrary(handle);
+    return 1;
+  }
+
+  // Ends once the parent closes its end of the socket.
+  Json::Value request {};
+  while (receiveMessage(socketFd, request)) {
+    Json::Value response {};
+    try {
+      response["result"] = dispatch(*ext, request);
+    } catch (const std::exception &e) {
+      response["error"] = e.what();
+    }
+
+    if (!sendMessage(socketFd, response))
+      break;
+  }
+
+  delete ext;
+  Utils::freeLibrary(handle);
+  return 0;
+}
+#endif
+
+std::tuple<std::vector<std::shared_ptr<Manga_t>>, bool> IsolatedExtension::getLatests(int page)
+{
+  Json::Value request {};
+  request["method"] = "getLatests";
+  request["page"] = page;
+
+  const auto result = call(request);
+  std::vector<std::shared_ptr<Manga_t>> entries {};
+  for (const auto &entry : result["entries"])
+    entries.push_back(toManga(entry));
+  return {entries, result["hasNext"].asBool()};
+}
+
+std::tuple<std::vector<std::shared_ptr<Manga_t>>, bool> IsolatedExtension::searchManga(
+  int page, const std::string &query, const std::vector<std::pair<std::string, std::string>> &filters)
+{
+  Json::Value request {};
+  request["method"] = "searchManga";
+  request["page"] = page;
+  request["query"] = query;
+  request["filters"] = Json::arrayValue;
+  for (const auto &[key, value] : filters) {
+    Json::Value filter {};
+    filter.append(key);
+    filter.append(value);
+    request["filters"].append(filter);
+  }
+
+  const auto result = call(request);
+  std::vector<std::shared_ptr<Manga_t>> entries {};
+  for (const auto &entry : result["entries"])
+    entries.push_back(toManga(entry));
+  return {entries, result["hasNext"].asBool()};
+}
+
+std::shared_ptr<Manga_t> IsolatedExtension::getManga(const std::string &path)
+{
+  Json::Value request {};
+  request["method"] = "getManga";
+  request["path"] = path;
+
+  const auto result = call(request);
+  if (result.isNull())
+    return nullptr;
+  return toManga(result);
+}
+
+std::vector<std::shared_ptr<Chapter_t>> IsolatedExtension::getChapters(const std::string &path)
+{
+  Json::Value request {};
+  request["method"] = "getChapters";
+  request["path"] = path;
+
+  std::vector<std::shared_ptr<Chapter_t>> chapters {};
+  for (const auto &chapter : call(request))
+    chapters.push_back(toChapter(chapter));
+  return chapters;
+}
+
+std::vector<std::string> IsolatedExtension::getPages(const std::string &path)
+{
+  Json::Value request {};
+  request["method"] = "getPages";
+  request["path"] = path;
+  return toStrings(call(request));
+}
+
+const Json::Value &IsolatedExtension::getFilters() const
+{
+  return filters;
+}
+
+const std::set<std::string> &IsolatedExtension::getFilterKeys() const
+{
+  return filterKeys;
+}
+
+Json::Value IsolatedExtension::getPrefs()
+{
+  Json::Value request {};
+  request["method"] = "getPrefs";
+  return call(request);
+}
+
+Json::Value IsolatedExtension::setPrefs(const Json::Value &prefs)
+{
+  // One change at a time, so a worker that made it has seen every earlier one
+  std::lock_guard lock(setPrefsMutex);
+  Json::Value request {};
+  request["method"] = "setPrefs";
+  request["prefs"] = prefs;
+  return call(request);
+}
+}  // namespace Sandbox
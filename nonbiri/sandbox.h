@@ -0,0 +1,84 @@
+#ifndef NONBIRI_SANDBOX_H_
+#define NONBIRI_SANDBOX_H_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <core/extension.h>
+#include <json/json.h>
+
+namespace Sandbox
+{
+struct Options
+{
+  // Worker processes per extension, started on demand
+  unsigned int workers {};
+  // CPU seconds a worker may use before it is killed and restarted, 0 disables
+  unsigned int cpuSeconds {};
+  // Megabytes of address space per worker, 0 disables
+  unsigned int memory {};
+  // Seconds a single call may take before the worker is killed, 0 disables
+  unsigned int timeout {};
+};
+
+class Worker;
+
+// Runs an extension library in a pool of child processes. Calls are sent
+// over a socket, payloads too large for a single datagram travel through a
+// memfd mapped by the receiver. A worker that crashes, exceeds its limits
+// or times out is killed and replaced on the next call. Filters and prefs
+// stay in the workers, preference changes are replayed to each of them.
+class IsolatedExtension : public Extension
+{
+  const Options mOptions;
+  int libraryFd {-1};
+
+  std::vector<std::unique_ptr<Worker>> workers {};
+  std::vector<Worker *> idle {};
+  std::mutex mutex {};
+  std::condition_variable cv {};
+
+  Json::Value filters {};
+  std::set<std::string> filterKeys {};
+  // The changes applied so far merged into one, later values of a pref
+  // replacing earlier ones, so it never outgrows the prefs themselves
+  Json::Value prefsChanges {};
+  // Bumped by every change, workers behind it get prefsChanges again
+  size_t prefsVersion {};
+  std::mutex prefsMutex {};
+  std::mutex setPrefsMutex {};
+
+public:
+  bool hasFilters {};
+  bool hasPrefs {};
+
+  IsolatedExtension(const std::string &path, const Options &options);
+  ~IsolatedExtension();
+
+  std::tuple<std::vector<std::shared_ptr<Manga_t>>, bool> getLatests(int page) override;
+  std::tuple<std::vector<std::shared_ptr<Manga_t>>, bool> searchManga(
+    int page, const std::string &query, const std::vector<std::pair<std::string, std::string>> &filters) override;
+  std::shared_ptr<Manga_t> getManga(const std::string &path) override;
+  std::vector<std::shared_ptr<Chapter_t>> getChapters(const std::string &path) override;
+  std::vector<std::string> getPages(const std::string &path) override;
+
+  // Filters as listed to clients, and the parameters passed on to searchManga
+  const Json::Value &getFilters() const;
+  const std::set<std::string> &getFilterKeys() const;
+  Json::Value getPrefs();
+  // Returns the prefs after the change
+  Json::Value setPrefs(const Json::Value &prefs);
+
+private:
+  Json::Value call(const Json::Value &request);
+};
+
+// Entry point of a worker process, see main().
+int serve();
+}  // namespace Sandbox
+
+#endif  // NONBIRI_SANDBOX_H_
@@ -3,18 +3,21 @@ CREATE TABLE IF NOT EXISTS author (
   name  TEXT NOT NULL
 );
 CREATE UNIQUE INDEX IF NOT EXISTS author_name_unique_idx ON author (name);
+CREATE INDEX IF NOT EXISTS author_name_nocase_idx ON author (name COLLATE NOCASE);
 
 CREATE TABLE IF NOT EXISTS genre (
   id    INTEGER PRIMARY KEY,
   name  TEXT NOT NULL
 );
 CREATE UNIQUE INDEX IF NOT EXISTS genre_name_unique_idx ON genre (name);
+CREATE INDEX IF NOT EXISTS genre_name_nocase_idx ON genre (name COLLATE NOCASE);
 
 CREATE TABLE IF NOT EXISTS scanlation_group (
   id    INTEGER PRIMARY KEY,
   name  TEXT NOT NULL
 );
 CREATE UNIQUE INDEX IF NOT EXISTS scanlation_group_name_unique_idx ON scanlation_group (name);
+CREATE INDEX IF NOT EXISTS scanlation_group_name_nocase_idx ON scanlation_group (name COLLATE NOCASE);
 
 CREATE TABLE IF NOT EXISTS manga (
   id                INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -46,6 +49,7 @@ CREATE INDEX IF NOT EXISTS manga_last_viewed_at_idx ON manga(last_viewed_at);
 CREATE INDEX IF NOT EXISTS manga_path_idx ON manga(path);
 CREATE INDEX IF NOT EXISTS manga_title_idx ON manga(title);
 CREATE INDEX IF NOT EXISTS manga_status_idx ON manga(status);
+CREATE INDEX IF NOT EXISTS manga_reading_status_idx ON manga(reading_status);
 
 CREATE TABLE IF NOT EXISTS manga_artists ( 
   manga_id  INTEGER NOT NULL REFERENCES manga (id),
@@ -108,3 +112,84 @@ CREATE TABLE IF NOT EXISTS chapter_scanlation_groups (
 );
 
 CREATE UNIQUE INDEX IF NOT EXISTS chapter_scanlation_groups_uidx ON chapter_scanlation_groups (chapter_id, scanlation_group_id);
+
+CREATE TABLE IF NOT EXISTS download_queue (
+  chapter_id  INTEGER PRIMARY KEY REFERENCES chapter (id),
+  added_at    INTEGER NOT NULL DEFAULT (strftime('%s', 'now')),
+  attempts    INTEGER DEFAULT 0,
+  error       TEXT
+);
+
+CREATE INDEX IF NOT EXISTS download_queue_added_at_idx ON download_queue(added_at);
+
+-- New chapters of library titles, newest last. Copies what the feed shows
+-- so a page of it is read straight off the primary key.
+CREATE TABLE IF NOT EXISTS updates_feed (
+  id            INTEGER PRIMARY KEY AUTOINCREMENT,
+  manga_id      INTEGER NOT NULL REFERENCES manga (id),
+  chapter_id    INTEGER NOT NULL REFERENCES chapter (id),
+  domain        TEXT NOT NULL,
+
+  added_at      INTEGER NOT NULL DEFAULT (strftime('%s', 'now')),
+  published_at  INTEGER NOT NULL,
+
+  manga_path    TEXT NOT NULL,
+  manga_title   TEXT NOT NULL,
+  cover_url     TEXT NOT NULL,
+  chapter_path  TEXT NOT NULL,
+  chapter_name  TEXT NOT NULL
+);
+
+CREATE UNIQUE INDEX IF NOT EXISTS updates_feed_chapter_uidx ON updates_feed(chapter_id);
+CREATE INDEX IF NOT EXISTS updates_feed_manga_id_idx ON updates_feed(manga_id);
+
+CREATE TRIGGER IF NOT EXISTS updates_feed_manga_delete AFTER DELETE ON manga
+BEGIN
+  DELETE FROM updates_feed WHERE manga_id = OLD.id;
+END;
+
+-- Every read, appended as it happens. The compactor keeps the newest entry
+-- of each title and a bounded tail of the rest.
+CREATE TABLE IF NOT EXISTS history (
+  id            INTEGER PRIMARY KEY AUTOINCREMENT,
+  domain        TEXT NOT NULL,
+  read_at       INTEGER NOT NULL DEFAULT (strftime('%s', 'now')),
+
+  manga_path    TEXT NOT NULL,
+  manga_title   TEXT NOT NULL,
+  cover_url     TEXT NOT NULL,
+  chapter_path  TEXT NOT NULL,
+  chapter_name  TEXT NOT NULL,
+  page          INTEGER DEFAULT 0
+);
+
+CREATE INDEX IF NOT EXISTS history_manga_idx ON history(domain, manga_path);
+
+-- The last change of every library chapter, kept up to date by the
+-- triggers below. ids only grow, so the highest one a client has seen is
+-- enough to tell it what changed since. Library chapters are never
+-- deleted, so there is nothing to tell about those.
+CREATE TABLE IF NOT EXISTS chapter_change (
+  id          INTEGER PRIMARY KEY AUTOINCREMENT,
+  manga_id    INTEGER NOT NULL,
+  chapter_id  INTEGER NOT NULL,
+  path        TEXT NOT NULL
+);
+
+CREATE UNIQUE INDEX IF NOT EXISTS chapter_change_chapter_uidx ON chapter_change(chapter_id);
+CREATE INDEX IF NOT EXISTS chapter_change_manga_id_idx ON chapter_change(manga_id, id);
+
+CREATE TRIGGER IF NOT EXISTS chapter_change_insert AFTER INSERT ON chapter
+BEGIN
+  INSERT OR REPLACE INTO chapter_change (manga_id, chapter_id, path) VALUES (NEW.manga_id, NEW.id, NEW.path);
+END;
+
+-- Only what the source lists counts as a change, reading, downloading and
+-- storing pages do not. Replaces the trigger that fired on any column.
+DROP TRIGGER IF EXISTS chapter_change_update;
+DROP TRIGGER IF EXISTS chapter_change_delete;
+CREATE TRIGGER IF NOT EXISTS chapter_change_source_update
+AFTER UPDATE OF manga_id, domain, path, name, published_at, updated_at ON chapter
+BEGIN
+  INSERT OR REPLACE INTO chapter_change (manga_id, chapter_id, path) VALUES (NEW.manga_id, NEW.id, NEW.path);
+END;
@@ -0,0 +1,55 @@
+#include <algorithm>
+
+#include <nonbiri/log.h>
+#include <nonbiri/metrics.h>
+#include <nonbiri/pool.h>
+#include <nonbiri/search.h>
+
+namespace Search
+{
+struct Task
+{
+  std::string domain {};
+  std::function<void()> fn {};
+};
+
+// Enough for every source of a few searches at once
+static constexpr size_t maxQueued {256};
+
+static SourcePool<Task> pool {};
+
+static Metrics::Counter &tasks(const std::string &result)
+{
+  return Metrics::counter("nonbiri_search_tasks_total", {{"result", result}});
+}
+
+static void run(Task &task)
+{
+  try {
+    task.fn();
+    tasks("done").increment();
+  } catch (const std::exception &e) {
+    tasks("failed").increment();
+    LOG_ERROR("Unable to search " << task.domain << ": " << e.what());
+  }
+}
+
+void initialize(const Options &options)
+{
+  pool.start(std::max(1U, options.threads), options.perSource, {run});
+}
+
+bool enqueue(const std::string &domain, std::function<void()> fn)
+{
+  {
+    std::lock_guard lock(pool.mutex);
+    if (pool.queue.size() >= maxQueued) {
+      tasks("rejected").increment();
+      return false;
+    }
+    pool.queue.push_back({domain, std::move(fn)});
+  }
+  pool.notify();
+  return true;
+}
+}  // namespace Search
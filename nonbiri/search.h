@@ -0,0 +1,24 @@
+#ifndef NONBIRI_SEARCH_H_
+#define NONBIRI_SEARCH_H_
+
+#include <functional>
+#include <string>
+
+// Runs the per-source searches of /api/search/all on a fixed set of threads
+// and never more than a few at once per source, so a burst of searches
+// queues up instead of starting a thread per source per request.
+namespace Search
+{
+struct Options
+{
+  unsigned int threads {};
+  // Searches allowed to run against one source at once
+  unsigned int perSource {};
+};
+
+void initialize(const Options &options);
+// Queues fn to run against domain, false when the queue is full
+bool enqueue(const std::string &domain, std::function<void()> fn);
+}  // namespace Search
+
+#endif  // NONBIRI_SEARCH_H_
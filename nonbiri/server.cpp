@@ -1,13 +1,191 @@
-#include <iostream>
+#include <algorithm>
+#include <array>
 
+#include <nonbiri/controllers/macro.h>
+#include <nonbiri/log.h>
 #include <nonbiri/server.h>
 
 Server *App::server = nullptr;
 
-Server::Server(int port) : httplib::Server(), mPort {port} {}
+// Releases the slot of the request being handled once the last copy goes
+static thread_local std::shared_ptr<void> *lease {};
+// Set on the thread answering connections the queue had no room for
+static thread_local bool isShedding {};
+// Threads answering shed connections, each one only writes a 503
+static constexpr size_t shedThreads {2};
+
+Server::Slots::Slots(const LaneOptions &options) : mOptions {options} {}
+
+bool Server::Slots::acquire()
+{
+  std::unique_lock lock(mutex);
+  if (running < mOptions.threads) {
+    running++;
+    return true;
+  }
+  if (waiting >= mOptions.depth)
+    return false;
+
+  waiting++;
+  cv.wait(lock, [this] { return running < mOptions.threads; });
+  waiting--;
+  running++;
+  return true;
+}
+
+void Server::Slots::release()
+{
+  {
+    std::lock_guard lock(mutex);
+    running--;
+  }
+  cv.notify_one();
+}
+
+unsigned int Server::Slots::capacity() const
+{
+  return mOptions.threads + mOptions.depth;
+}
+
+Server::Queue::Queue(size_t threads, size_t depth) : mDepth {depth}
+{
+  for (size_t i = 0; i < threads; i++)
+    this->threads.emplace_back([this] { work(tasks, cv, false); });
+  for (size_t i = 0; i < shedThreads; i++)
+    this->threads.emplace_back([this] { work(shed, shedCv, true); });
+}
+
+void Server::Queue::work(std::deque<std::function<void()>> &queue, std::condition_variable &queueCv, bool isShedQueue)
+{
+  isShedding = isShedQueue;
+  while (true) {
+    std::function<void()> fn {};
+    {
+      std::unique_lock lock(mutex);
+      queueCv.wait(lock, [&] { return isShutdown || !queue.empty(); });
+      if (queue.empty())
+        return;
+      fn = std::move(queue.front());
+      queue.pop_front();
+    }
+    fn();
+  }
+}
+
+bool Server::Queue::enqueue(std::function<void()> fn)
+{
+  static auto &refused = Metrics::counter("nonbiri_http_connections_refused_total");
+
+  std::unique_lock lock(mutex);
+  if (tasks.size() < mDepth) {
+    tasks.push_back(std::move(fn));
+    lock.unlock();
+    cv.notify_one();
+    return true;
+  }
+  if (shed.size() < mDepth) {
+    shed.push_back(std::move(fn));
+    lock.unlock();
+    shedCv.notify_one();
+    return true;
+  }
+  lock.unlock();
+
+  // Both queues are full, httplib closes the connection unread
+  refused.increment();
+  return false;
+}
+
+void Server::Queue::shutdown()
+{
+  {
+    std::lock_guard lock(mutex);
+    isShutdown = true;
+  }
+  cv.notify_all();
+  shedCv.notify_all();
+  for (auto &thread : threads)
+    thread.join();
+}
+
+Server::Server(int port, const LaneOptions &localOptions, const LaneOptions &remoteOptions) :
+  httplib::Server(),
+  mPort {port},
+  local {localOptions},
+  remote {remoteOptions}
+{
+  // Every admitted request holds a connection thread while it runs or waits
+  // for its lane, so the pool is sized to fit both lanes at full capacity.
+  // This way a burst of slow scrapes can never take the threads reserved for
+  // local requests. As many connections may wait for a thread as the lanes
+  // let requests wait for a slot.
+  new_task_queue = [this, localOptions, remoteOptions] {
+    return new Queue(local.capacity() + remote.capacity(), std::max(1U, localOptions.depth + remoteOptions.depth));
+  };
+}
+
+void Server::Get(const std::string &pattern, Lane lane, const Handler &handler)
+{
+  httplib::Server::Get(pattern, dispatch(pattern, lane, handler));
+}
+
+void Server::Post(const std::string &pattern, Lane lane, const Handler &handler)
+{
+  httplib::Server::Post(pattern, dispatch(pattern, lane, handler));
+}
+
+void Server::Delete(const std::string &pattern, Lane lane, const Handler &handler)
+{
+  httplib::Server::Delete(pattern, dispatch(pattern, lane, handler));
+}
 
 void Server::start()
 {
-  std::cout << "Server listening on " << mPort << std::endl;
+  LOG_INFO("Server listening on " << mPort);
   listen("localhost", mPort);
 }
+
+std::shared_ptr<void> Server::holdSlot()
+{
+  return lease != nullptr ? *lease : nullptr;
+}
+
+httplib::Server::Handler Server::dispatch(const std::string &pattern, Lane lane, const Handler &handler)
+{
+  Slots &slots = lane == Lane::Remote ? remote : local;
+  auto &shed = Metrics::counter("nonbiri_http_requests_shed_total", {{"lane", lane == Lane::Remote ? "remote" : "local"}});
+  auto &duration = Metrics::histogram("nonbiri_http_request_duration_seconds", {{"route", pattern}});
+
+  std::array<Metrics::Counter *, 5> responses {};
+  for (size_t i = 0; i < responses.size(); i++)
+    responses[i] = &Metrics::counter("nonbiri_http_responses_total", {{"route", pattern}, {"code", std::to_string(i + 1) + "xx"}});
+
+  return [&slots, &shed, &duration, responses, handler](const httplib::Request &req, httplib::Response &res) {
+    if (isShedding || !slots.acquire()) {
+      shed.increment();
+      responses[4]->increment();
+      if (isShedding)
+        res.set_header("Connection", "close");
+      res.set_header("Retry-After", "1");
+      REPLY(503, JSON_ERROR("Server is busy"), MIME_JSON);
+      return;
+    }
+
+    {
+      Metrics::Timer timer(duration);
+      std::shared_ptr<void> slot(nullptr, [&slots](void *) { slots.release(); });
+      lease = &slot;
+      try {
+        handler(req, res);
+      } catch (...) {
+        lease = nullptr;
+        throw;
+      }
+      lease = nullptr;
+    }
+
+    const int status = res.status > 0 ? res.status : 200;
+    const size_t index = std::clamp(status / 100, 1, 5) - 1;
+    responses[index]->increment();
+  };
+}
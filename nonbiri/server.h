@@ -6,23 +6,101 @@
 #  include <Windows.h>
 #endif
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <httplib.h>
+#include <nonbiri/metrics.h>
 
 class Server : private httplib::Server
 {
+public:
+  // Local requests only touch the database/cache, remote requests may end up
+  // calling into an extension and wait on the network.
+  enum class Lane
+  {
+    Local,
+    Remote
+  };
+
+  struct LaneOptions
+  {
+    unsigned int threads;
+    unsigned int depth;
+  };
+
+private:
+  // Caps how many handlers of a lane run at once and how many may wait for a
+  // free slot, anything above that is shed with 503.
+  class Slots
+  {
+    const LaneOptions mOptions;
+    unsigned int running {};
+    unsigned int waiting {};
+    std::mutex mutex;
+    std::condition_variable cv;
+
+  public:
+    Slots(const LaneOptions &options);
+
+    bool acquire();
+    void release();
+    unsigned int capacity() const;
+  };
+
+  // Accepted connections wait here for a thread, up to depth of them. The
+  // lane of a connection is only known once its request is read, so the next
+  // depth connections go to a thread that answers every request on them with
+  // 503 and closes them. Past that enqueue() refuses them and httplib closes
+  // them unread, the accepting thread never serves one itself.
+  class Queue : public httplib::TaskQueue
+  {
+    const size_t mDepth;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::condition_variable shedCv;
+    std::deque<std::function<void()>> tasks;
+    std::deque<std::function<void()>> shed;
+    std::vector<std::thread> threads;
+    bool isShutdown {};
+
+    void work(std::deque<std::function<void()>> &queue, std::condition_variable &queueCv, bool isShedQueue);
+
+  public:
+    Queue(size_t threads, size_t depth);
+
+    bool enqueue(std::function<void()> fn) override;
+    void shutdown() override;
+  };
+
   const int mPort;
+  Slots local;
+  Slots remote;
 
 public:
-  Server(int port);
+  Server(int port, const LaneOptions &localOptions, const LaneOptions &remoteOptions);
 
-  using httplib::Server::Delete;
-  using httplib::Server::Get;
-  using httplib::Server::Patch;
-  using httplib::Server::Post;
-  using httplib::Server::Put;
   using httplib::Server::set_mount_point;
 
+  void Get(const std::string &pattern, Lane lane, const Handler &handler);
+  void Post(const std::string &pattern, Lane lane, const Handler &handler);
+  void Delete(const std::string &pattern, Lane lane, const Handler &handler);
+
   void start();
+
+  // Keeps the lane slot of the request handled on this thread taken until
+  // the returned handle is dropped, for responses that stream after their
+  // handler returned. Empty outside of a handler.
+  static std::shared_ptr<void> holdSlot();
+
+private:
+  Handler dispatch(const std::string &pattern, Lane lane, const Handler &handler);
 };
 
 namespace App
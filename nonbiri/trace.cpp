@@ -0,0 +1,177 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <json/json.h>
+#include <nonbiri/metrics.h>
+#include <nonbiri/trace.h>
+
+namespace Trace
+{
+static constexpr size_t bufferSize {4096};
+static constexpr size_t retainedEvents {1 << 16};
+static constexpr auto drainInterval {std::chrono::milliseconds(100)};
+
+// Single producer (the owning thread), single consumer (the drainer).
+struct Buffer
+{
+  std::array<Event, bufferSize> events {};
+  std::atomic<size_t> head {};
+  std::atomic<size_t> tail {};
+  std::atomic<bool> orphaned {};
+  uint32_t tid {};
+};
+
+struct Collector
+{
+  std::mutex buffersMutex {};
+  std::vector<std::shared_ptr<Buffer>> buffers {};
+  std::atomic<uint32_t> nextTid {1};
+
+  std::mutex eventsMutex {};
+  std::deque<Event> events {};
+};
+
+static Collector &collector()
+{
+  static Collector instance {};
+  return instance;
+}
+
+static void drain()
+{
+  auto &c = collector();
+  std::vector<Event> batch {};
+
+  {
+    std::lock_guard lock(c.buffersMutex);
+    for (auto it = c.buffers.begin(); it != c.buffers.end();) {
+      auto &buffer = **it;
+      const size_t head = buffer.head.load(std::memory_order_acquire);
+      size_t tail = buffer.tail.load(std::memory_order_relaxed);
+      for (; tail != head; tail++)
+        batch.push_back(buffer.events[tail % bufferSize]);
+      buffer.tail.store(tail, std::memory_order_release);
+
+      if (buffer.orphaned.load(std::memory_order_acquire) && tail == buffer.head.load(std::memory_order_acquire))
+        it = c.buffers.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  if (batch.empty())
+    return;
+
+  std::lock_guard lock(c.eventsMutex);
+  c.events.insert(c.events.end(), batch.begin(), batch.end());
+  while (c.events.size() > retainedEvents)
+    c.events.pop_front();
+}
+
+// Owned by a thread_local, marks the buffer for removal once the thread exits.
+struct Registration
+{
+  std::shared_ptr<Buffer> buffer {std::make_shared<Buffer>()};
+
+  Registration()
+  {
+    static std::once_flag once {};
+    std::call_once(once, [] {
+      std::thread([] {
+        while (true) {
+          std::this_thread::sleep_for(drainInterval);
+          drain();
+        }
+      }).detach();
+    });
+
+    auto &c = collector();
+    buffer->tid = c.nextTid.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard lock(c.buffersMutex);
+    c.buffers.push_back(buffer);
+  }
+
+  ~Registration()
+  {
+    buffer->orphaned.store(true, std::memory_order_release);
+  }
+};
+
+uint64_t now()
+{
+  static const auto epoch = std::chrono::steady_clock::now();
+  const auto elapsed = std::chrono::steady_clock::now() - epoch;
+  return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void record(const char *name, uint64_t start, uint64_t end)
+{
+  static auto &dropped = Metrics::counter("nonbiri_trace_events_dropped_total");
+  thread_local Registration registration {};
+  auto &buffer = *registration.buffer;
+
+  const size_t head = buffer.head.load(std::memory_order_relaxed);
+  if (head - buffer.tail.load(std::memory_order_acquire) >= bufferSize) {
+    dropped.increment();
+    return;
+  }
+
+  auto &event = buffer.events[head % bufferSize];
+  strncpy(event.name, name, sizeof(event.name) - 1);
+  event.name[sizeof(event.name) - 1] = '\0';
+  event.start = start;
+  event.duration = end - start;
+  event.tid = buffer.tid;
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+std::string render()
+{
+  drain();
+
+  auto &c = collector();
+  Json::Value root {};
+  root["displayTimeUnit"] = "ms";
+  root["traceEvents"] = Json::arrayValue;
+
+  std::lock_guard lock(c.eventsMutex);
+  for (const auto &event : c.events) {
+    Json::Value json {};
+    json["name"] = event.name;
+    json["cat"] = "nonbiri";
+    json["ph"] = "X";
+    json["ts"] = static_cast<Json::UInt64>(event.start);
+    json["dur"] = static_cast<Json::UInt64>(event.duration);
+    json["pid"] = 1;
+    json["tid"] = event.tid;
+    root["traceEvents"].append(json);
+  }
+
+  Json::FastWriter writer {};
+  return writer.write(root);
+}
+
+void clear()
+{
+  drain();
+
+  auto &c = collector();
+  std::lock_guard lock(c.eventsMutex);
+  c.events.clear();
+}
+
+Span::Span(const char *name) : mName {name}, mStart {now()} {}
+
+Span::~Span()
+{
+  record(mName, mStart, now());
+}
+}  // namespace Trace
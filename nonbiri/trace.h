@@ -0,0 +1,40 @@
+#ifndef NONBIRI_TRACE_H_
+#define NONBIRI_TRACE_H_
+
+#include <cstdint>
+#include <string>
+
+namespace Trace
+{
+struct Event
+{
+  char name[64];
+  uint64_t start;
+  uint64_t duration;
+  uint32_t tid;
+};
+
+// Microseconds since the process started.
+uint64_t now();
+
+// Appends a completed span to the calling thread's ring buffer. Never blocks,
+// if the buffer is full the event is dropped and counted.
+void record(const char *name, uint64_t start, uint64_t end);
+
+// Renders the spans collected so far in the Chrome trace-event format, which
+// can be loaded into chrome://tracing or Perfetto.
+std::string render();
+void clear();
+
+class Span
+{
+  const char *mName;
+  const uint64_t mStart;
+
+public:
+  Span(const char *name);
+  ~Span();
+};
+}  // namespace Trace
+
+#endif  // NONBIRI_TRACE_H_
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <deque>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <nonbiri/log.h>
+#include <nonbiri/manager.h>
+#include <nonbiri/metrics.h>
+#include <nonbiri/pool.h>
+#include <nonbiri/updates.h>
+
+namespace Updates
+{
+struct Job
+{
+  std::string domain {};
+  std::shared_ptr<Manga> manga {};
+};
+
+struct Run
+{
+  time_t startedAt {};
+  time_t finishedAt {};
+  size_t total {};
+  size_t done {};
+  size_t failed {};
+  size_t chapters {};
+};
+
+// The first scheduled run waits for the server to settle
+static constexpr auto firstRunDelay {std::chrono::minutes(5)};
+
+static Options options {};
+// Its mutex guards run as well
+static SourcePool<Job> pool {};
+static Run run {};
+
+static Metrics::Counter &titles(const std::string &result)
+{
+  return Metrics::counter("nonbiri_library_update_titles_total", {{"result", result}});
+}
+
+static void check(Manga &manga)
+{
+  static auto &chapters = Metrics::counter("nonbiri_library_update_chapters_total");
+  const auto ext = App::manager->getExtension(manga.domain);
+  if (ext == nullptr)
+    throw std::runtime_error("Extension not found");
+
+  const auto found = App::manager->updateChapters(*ext, manga);
+  chapters.increment(found.size());
+  if (found.empty())
+    return;
+
+  LOG_INFO("Found " << found.size() << " new chapters of " << manga.title);
+  std::lock_guard lock(pool.mutex);
+  run.chapters += found.size();
+}
+
+static void work(Job &job)
+{
+  thread_local std::mt19937 random {std::random_device {}()};
+  if (options.jitter > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(std::uniform_int_distribution<unsigned int>(0, options.jitter)(random)));
+
+  bool isFailed {};
+  try {
+    check(*job.manga);
+    titles("done").increment();
+  } catch (const std::exception &e) {
+    isFailed = true;
+    titles("failed").increment();
+    LOG_ERROR("Unable to check " << job.domain << job.manga->path << " for updates: " << e.what());
+  }
+
+  std::lock_guard lock(pool.mutex);
+  run.done++;
+  if (isFailed)
+    run.failed++;
+  if (run.done == run.total) {
+    run.finishedAt = time(nullptr);
+    LOG_INFO("Checked " << run.total << " titles for updates in " << run.finishedAt - run.startedAt << "s, " << run.chapters
+                        << " new chapters");
+  }
+}
+
+void initialize(const Options &opts)
+{
+  options = opts;
+  pool.start(options.threads, options.perSource, {work});
+
+  if (options.threads == 0 || options.interval == 0)
+    return;
+  std::thread([] {
+    std::this_thread::sleep_for(firstRunDelay);
+    while (true) {
+      try {
+        start();
+      } catch (const std::exception &e) {
+        LOG_ERROR("Unable to start library update: " << e.what());
+      }
+      std::this_thread::sleep_for(std::chrono::minutes(options.interval));
+    }
+  }).detach();
+}
+
+bool start()
+{
+  if (options.threads == 0)
+    throw std::runtime_error("Library updates are disabled");
+
+  {
+    std::lock_guard lock(pool.mutex);
+    if (run.startedAt > 0 && run.finishedAt == 0)
+      return false;
+  }
+
+  auto manga = Manga::findAllFollowed();
+  {
+    std::lock_guard lock(pool.mutex);
+    if (run.startedAt > 0 && run.finishedAt == 0)
+      return false;
+    run = {time(nullptr), 0, manga.size()};
+    if (manga.empty())
+      run.finishedAt = run.startedAt;
+    // Sources come in turns instead of one after the other, so every
+    // worker has a title it is allowed to check
+    std::map<std::string, std::deque<std::shared_ptr<Manga>>> byDomain {};
+    for (auto &m : manga)
+      byDomain[m->domain].push_back(std::move(m));
+    while (!byDomain.empty()) {
+      for (auto it = byDomain.begin(); it != byDomain.end();) {
+        pool.queue.push_back({it->first, std::move(it->second.front())});
+        it->second.pop_front();
+        it = it->second.empty() ? byDomain.erase(it) : std::next(it);
+      }
+    }
+  }
+  pool.notify();
+  return true;
+}
+
+Json::Value status()
+{
+  std::lock_guard lock(pool.mutex);
+  Json::Value root {};
+  root["isRunning"] = run.startedAt > 0 && run.finishedAt == 0;
+  if (run.startedAt > 0)
+    root["startedAt"] = static_cast<Json::Int64>(run.startedAt);
+  if (run.finishedAt > 0)
+    root["finishedAt"] = static_cast<Json::Int64>(run.finishedAt);
+  root["total"] = static_cast<Json::UInt64>(run.total);
+  root["done"] = static_cast<Json::UInt64>(run.done);
+  root["failed"] = static_cast<Json::UInt64>(run.failed);
+  root["chapters"] = static_cast<Json::UInt64>(run.chapters);
+  return root;
+}
+}  // namespace Updates
@@ -0,0 +1,31 @@
+#ifndef NONBIRI_UPDATES_H_
+#define NONBIRI_UPDATES_H_
+
+#include <json/json.h>
+
+// Checks the followed titles of the library for new chapters. A run walks
+// every title being read, planned or on hold, a few at a time per source,
+// and stores the chapters the sources list that the library lacks.
+namespace Updates
+{
+struct Options
+{
+  unsigned int threads {};
+  // Titles checked against one source at once
+  unsigned int perSource {};
+  // Minutes between scheduled runs, 0 leaves runs to the API
+  unsigned int interval {};
+  // Up to this many milliseconds of random delay before each title, so
+  // checks against a source do not go out in lockstep
+  unsigned int jitter {};
+};
+
+void initialize(const Options &options);
+// Queues a run through the library, false if one is still going
+bool start();
+// Progress of the current or last run. The chapters it finds go to the
+// updates feed.
+Json::Value status();
+}  // namespace Updates
+
+#endif  // NONBIRI_UPDATES_H_
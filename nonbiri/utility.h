@@ -1,21 +1,15 @@
 #ifndef NONBIRI_UTILITY_H_
 #define NONBIRI_UTILITY_H_
 
-#include <chrono>
-#include <string>
-
 #include <core/utility.h>
+#include <nonbiri/trace.h>
 
 namespace Utils
 {
-struct ExecTime
+// Records the lifetime of the enclosing scope as a trace span, see /debug/trace.
+struct ExecTime : Trace::Span
 {
-  const std::string name;
-  std::chrono::high_resolution_clock::time_point start;
-  std::chrono::high_resolution_clock::time_point end;
-
-  ExecTime(const std::string &name);
-  ~ExecTime();
+  ExecTime(const char *name);
 };
 }  // namespace Utils
 